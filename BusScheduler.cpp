@@ -0,0 +1,56 @@
+#include "BusScheduler.h"
+
+int8_t BusScheduler::addDisplay(ChunkedUpdate& display, uint8_t priority, size_t chunkBytes) {
+  if (numJobs_ >= kMaxDisplays) {
+    return -1;
+  }
+  Job& job = jobs_[numJobs_];
+  job.display = &display;
+  job.priority = priority;
+  job.chunkBytes = chunkBytes;
+  job.pending = false;
+  job.stats = Stats();
+  return numJobs_++;
+}
+
+void BusScheduler::requestUpdate(uint8_t display, uint32_t deadlineUs) {
+  Job& job = jobs_[display];
+  uint32_t now = timer_.read_us();
+  uint32_t deadline = now + deadlineUs;
+  job.display->beginUpdate();
+  if (!job.pending) {
+    job.pending = true;
+    job.requestedUs = now;
+    job.deadlineUs = deadline;
+  } else if ((int32_t)(deadline - job.deadlineUs) < 0) {
+    job.deadlineUs = deadline;
+  }
+}
+
+bool BusScheduler::runChunk() {
+  Job* next = NULL;
+  for (uint8_t i=0; i<numJobs_; i++) {
+    if (jobs_[i].pending && (next == NULL || moreUrgent(jobs_[i], *next))) {
+      next = &jobs_[i];
+    }
+  }
+  if (next == NULL) {
+    return false;
+  }
+
+  if (next->display->updateChunk(next->chunkBytes)) {
+    uint32_t now = timer_.read_us();
+    uint32_t latency = now - next->requestedUs;
+    next->pending = false;
+    next->stats.updates++;
+    if ((int32_t)(now - next->deadlineUs) > 0) {
+      next->stats.missedDeadlines++;
+    }
+    next->stats.lastLatencyUs = latency;
+    if (latency > next->stats.maxLatencyUs) {
+      next->stats.maxLatencyUs = latency;
+    }
+    next->stats.totalLatencyUs += latency;
+  }
+  return true;
+}
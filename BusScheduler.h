@@ -0,0 +1,113 @@
+#ifndef _BUS_SCHEDULER_H_
+#define _BUS_SCHEDULER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "mbed.h"
+#include "DisplayBus.h"
+#include "GraphicsApi.h"
+
+/**
+ * Adapter to schedule a display without chunked updates, whose update() is sent as one chunk.
+ */
+class WholeUpdate : public ChunkedUpdate {
+public:
+  WholeUpdate(GraphicsApi& display) :
+      display_(display) {
+  }
+
+  void beginUpdate() {
+  }
+
+  bool updateChunk(size_t) {  // whole updates ignore the chunk budget
+    display_.update();
+    return true;
+  }
+
+protected:
+  GraphicsApi& display_;
+};
+
+/**
+ * Interleaves updates of several displays sharing a DisplayBus, a chunk at a time, so a large frame
+ * on one display doesn't hold off a latency-critical update on another.
+ *
+ * Each chunk goes to the pending update with the earliest deadline, ties broken by display priority.
+ * Call runChunk() (or runUntilIdle()) from the main loop; each call sends one chunk and returns.
+ */
+class BusScheduler {
+public:
+  static const uint8_t kMaxDisplays = 4;
+
+  struct Stats {
+    uint32_t updates;  // completed updates
+    uint32_t missedDeadlines;  // updates completed after their deadline
+    uint32_t lastLatencyUs;  // from requestUpdate to completion
+    uint32_t maxLatencyUs;
+    uint64_t totalLatencyUs;  // for the average, over updates
+  };
+
+  BusScheduler() {
+    timer_.start();
+  }
+
+  /**
+   * Registers a display, returning its index to request updates with, or -1 if kMaxDisplays are registered.
+   * Higher priorities win between updates with equal deadlines.
+   * Each chunk sends at most about chunkBytes, bounding how long another display waits for the bus.
+   */
+  int8_t addDisplay(ChunkedUpdate& display, uint8_t priority = 0, size_t chunkBytes = 1024);
+
+  /**
+   * Requests an update of a display's current framebuffer contents, to complete within deadlineUs.
+   * If an update is already pending, the framebuffer is merged into it and the earlier deadline kept.
+   */
+  void requestUpdate(uint8_t display, uint32_t deadlineUs);
+
+  // Sends one chunk of the most urgent pending update. Returns false if none was pending.
+  bool runChunk();
+
+  void runUntilIdle() {
+    while (runChunk());
+  }
+
+  bool isPending(uint8_t display) const {
+    return jobs_[display].pending;
+  }
+
+  const Stats& getStats(uint8_t display) const {
+    return jobs_[display].stats;
+  }
+
+  void resetStats(uint8_t display) {
+    jobs_[display].stats = Stats();
+  }
+
+protected:
+  struct Job {
+    ChunkedUpdate* display;
+    uint8_t priority;
+    size_t chunkBytes;
+
+    bool pending;
+    uint32_t requestedUs;
+    uint32_t deadlineUs;  // absolute, in timer_ time
+
+    Stats stats;
+  };
+
+  // Returns whether a should be sent before b, both pending
+  static bool moreUrgent(const Job& a, const Job& b) {
+    int32_t deadlineDiff = (int32_t)(a.deadlineUs - b.deadlineUs);  // wraparound-safe
+    if (deadlineDiff != 0) {
+      return deadlineDiff < 0;
+    }
+    return a.priority > b.priority;
+  }
+
+  Job jobs_[kMaxDisplays] = {};
+  uint8_t numJobs_ = 0;
+  Timer timer_;
+};
+
+#endif
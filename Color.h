@@ -0,0 +1,110 @@
+#ifndef _COLOR_H_
+#define _COLOR_H_
+
+#include <cstdint>
+
+/**
+ * 24-bit RGB color, packed as 0xRRGGBB.
+ */
+class Color {
+public:
+  constexpr Color(uint8_t r, uint8_t g, uint8_t b) :
+      rgb_(((uint32_t)r << 16) | ((uint32_t)g << 8) | b) {
+  }
+
+  static constexpr Color fromRgb(uint32_t rgb) {
+    return Color((rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff);
+  }
+
+  constexpr uint8_t r() const {
+    return (rgb_ >> 16) & 0xff;
+  }
+  constexpr uint8_t g() const {
+    return (rgb_ >> 8) & 0xff;
+  }
+  constexpr uint8_t b() const {
+    return rgb_ & 0xff;
+  }
+  constexpr uint32_t rgb() const {
+    return rgb_;
+  }
+
+  // Returns the monochrome contrast, averaging the R, G, B components
+  constexpr uint8_t toContrast() const {
+    return ((uint16_t)r() + g() + b()) / 3;
+  }
+
+protected:
+  uint32_t rgb_;
+};
+
+/**
+ * Conversions from colors and contrasts to display-native pixel values, one struct per format
+ * so backends select theirs as a template argument and conversions of constants fold at compile time.
+ */
+struct Gray4Format {  // 4-bit gray, as in SSD1322 display RAM
+  typedef uint8_t Pixel;
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return contrast >> 4;
+  }
+  static constexpr Pixel fromColor(Color color) {
+    return fromContrast(color.toContrast());
+  }
+};
+
+struct Mono1Format {  // 1-bit, set above half contrast
+  typedef bool Pixel;
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return contrast >= 127;
+  }
+  static constexpr Pixel fromColor(Color color) {
+    return fromContrast(color.toContrast());
+  }
+};
+
+struct TriColorFormat {  // black / white / red e-ink
+  enum Pixel {
+    kWhite,
+    kBlack,
+    kRed,
+  };
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return contrast >= 127 ? kWhite : kBlack;
+  }
+  // Red where the red component dominates, otherwise thresholded gray
+  static constexpr Pixel fromColor(Color color) {
+    return (color.r() >= 128 && color.g() < 128 && color.b() < 128) ? kRed : fromContrast(color.toContrast());
+  }
+};
+
+struct Rgb444Format {  // 12-bit color, as 0x0RGB
+  typedef uint16_t Pixel;
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return (contrast >> 4) * 0x111;
+  }
+  static constexpr Pixel fromColor(Color color) {
+    return ((uint16_t)(color.r() >> 4) << 8) | ((color.g() >> 4) << 4) | (color.b() >> 4);
+  }
+};
+
+struct Rgb565Format {  // 16-bit color, as 0bRRRRRGGGGGGBBBBB
+  typedef uint16_t Pixel;
+  static constexpr Pixel fromColor(Color color) {
+    return ((uint16_t)(color.r() >> 3) << 11) | ((uint16_t)(color.g() >> 2) << 5) | (color.b() >> 3);
+  }
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return fromColor(Color(contrast, contrast, contrast));
+  }
+};
+
+struct Rgb666Format {  // 18-bit color, as 0xRRGGBB with the low 2 bits of each component clear
+  typedef uint32_t Pixel;
+  static constexpr Pixel fromColor(Color color) {
+    return color.rgb() & 0xfcfcfc;
+  }
+  static constexpr Pixel fromContrast(uint8_t contrast) {
+    return fromColor(Color(contrast, contrast, contrast));
+  }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "DisplayBus.h"
+
+#include <algorithm>
+#include <cstring>
+
+void DisplayBusDevice::fill(uint8_t payload, size_t len) {
+  uint8_t block[kFillBlockBytes];
+  memset(block, payload, std::min(len, sizeof(block)));
+  while (len > 0) {
+    size_t blockLen = std::min(len, sizeof(block));
+    data(block, blockLen);
+    len -= blockLen;
+  }
+}
+
+size_t DisplayBusDevice::runSequence(const uint8_t sequence[], size_t len, size_t offset, uint8_t& delayMs) {
+  while (offset < len) {
+    uint8_t index = sequence[offset++];
+    uint8_t count = sequence[offset++];
+    command(index, sequence + offset, count & ~kSequenceDelay);
+    offset += count & ~kSequenceDelay;
+    if (count & kSequenceDelay) {
+      delayMs = sequence[offset++];
+      release();  // free the bus for other displays during the wait
+      return offset;
+    }
+  }
+  delayMs = 0;
+  return len;
+}
+
+void DisplayBusDevice::select() {
+  if (bus_.owner_ != this) {
+    if (bus_.owner_ != NULL) {
+      bus_.owner_->release();
+    }
+    bus_.owner_ = this;
+    dcLevel_ = 0xff;  // data/command may be shared with, and changed by, other displays
+    if (bus_.frequency_ != frequency_ || bus_.mode_ != mode_) {
+      bus_.spi_.format(8, mode_);
+      bus_.spi_.frequency(frequency_);
+      bus_.frequency_ = frequency_;
+      bus_.mode_ = mode_;
+    }
+  }
+  if (!selected_) {
+    cs_ = 0;
+    selected_ = true;
+  }
+}
@@ -0,0 +1,141 @@
+#ifndef _DISPLAY_BUS_H_
+#define _DISPLAY_BUS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "mbed.h"
+
+class DisplayBusDevice;
+
+/**
+ * SPI bus shared by one or more displays, each with its own chip select line.
+ * Tracks which display last used the bus and the SPI settings last applied, so the SPI peripheral
+ * is only reconfigured when switching to a display with different settings.
+ */
+class DisplayBus {
+public:
+  DisplayBus(SPI& spi) :
+      spi_(spi) {
+  }
+
+protected:
+  friend class DisplayBusDevice;
+
+  SPI& spi_;
+  DisplayBusDevice* owner_ = NULL;  // display holding (or that last held) the bus
+  int frequency_ = 0;  // SPI settings last applied, 0 if never configured
+  uint8_t mode_ = 0;
+};
+
+/**
+ * A display's connection to a DisplayBus, through which commands and data are sent.
+ *
+ * Chip select is asserted on the first transfer and held until release(), so a command,
+ * its parameters and any following pixel data go out in one transaction. Pin writes are elided
+ * when the pin is already in the needed state. Selecting another display on the same bus releases
+ * this one first, so drivers sharing a bus only need to release() at the end of each operation.
+ */
+class DisplayBusDevice {
+public:
+  DisplayBusDevice(DisplayBus& bus, DigitalOut& cs, DigitalOut& dc, int frequency, uint8_t mode = 0) :
+      bus_(bus), cs_(cs), dc_(dc), frequency_(frequency), mode_(mode) {
+    cs_ = 1;
+  }
+
+  void command(uint8_t index) {
+    select();
+    setDc(0);
+    bus_.spi_.write(index);
+  }
+
+  // Sends a command followed by its parameters
+  void command(uint8_t index, const uint8_t params[], size_t len) {
+    command(index);
+    data(params, len);
+  }
+
+  void data(uint8_t payload) {
+    select();
+    setDc(1);
+    bus_.spi_.write(payload);
+  }
+
+  // Sends a block of data bytes as one SPI transfer
+  void data(const uint8_t payload[], size_t len) {
+    if (len == 0) {
+      return;
+    }
+    select();
+    setDc(1);
+    bus_.spi_.write((const char*)payload, len, NULL, 0);
+  }
+
+  // Sends len copies of a data byte, in blocks
+  void fill(uint8_t payload, size_t len);
+
+  // Flag in a sequence entry's parameter count, for entries followed by a delay in ms
+  static constexpr uint8_t kSequenceDelay = 0x80;
+
+  /**
+   * Runs a command sequence table of len bytes from offset, as one transaction held until release().
+   * Each entry is the command, its parameter count (ORed with kSequenceDelay if a delay follows), the
+   * parameters, then the delay. Sequences do not wait: the run stops after a delayed entry, releasing the
+   * bus and setting delayMs, for the caller to resume from the returned offset after its
+   * DisplayTask::delay(). Returns len once the table is done.
+   * Tables are constexpr, so they stay in flash.
+   */
+  size_t runSequence(const uint8_t sequence[], size_t len, size_t offset, uint8_t& delayMs);
+
+  // Runs a command sequence table without delays
+  void runSequence(const uint8_t sequence[], size_t len) {
+    uint8_t delayMs;
+    runSequence(sequence, len, 0, delayMs);
+  }
+
+  // Ends the current transaction, deasserting chip select
+  void release() {
+    if (selected_) {
+      cs_ = 1;
+      selected_ = false;
+    }
+  }
+
+protected:
+  // Takes the bus from any other display and asserts chip select
+  void select();
+
+  void setDc(uint8_t level) {
+    if (dcLevel_ != level) {
+      dc_ = level;
+      dcLevel_ = level;
+    }
+  }
+
+  static const size_t kFillBlockBytes = 32;
+
+  DisplayBus& bus_;
+  DigitalOut& cs_;
+  DigitalOut& dc_;
+  const int frequency_;
+  const uint8_t mode_;
+
+  bool selected_ = false;
+  uint8_t dcLevel_ = 0xff;  // last level written to dc, 0xff when unknown
+};
+
+/**
+ * A display whose update can be sent in bounded chunks, releasing the bus between them,
+ * so an update of one display sharing a bus can be interleaved with others (see BusScheduler).
+ * Drawing between chunks of an update may tear, as rows already sent are not resent until the next update.
+ */
+class ChunkedUpdate {
+public:
+  // Starts an update of the current framebuffer contents, merging with any update in progress
+  virtual void beginUpdate() = 0;
+
+  // Sends the next chunk of the update in progress, at most about maxBytes (but at least a row).
+  // Returns true once the update is complete.
+  virtual bool updateChunk(size_t maxBytes) = 0;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#include "DisplayTask.h"
+
+bool TaskExecutor::add(DisplayTask& task) {
+  if (numTasks_ >= kMaxTasks) {
+    return false;
+  }
+  tasks_[numTasks_++] = &task;
+  return true;
+}
+
+bool TaskExecutor::poll() {
+  uint8_t i = 0;
+  while (i < numTasks_) {
+    if (tasks_[i]->poll(clock_.nowUs())) {
+      numTasks_--;
+      for (uint8_t j=i; j<numTasks_; j++) {
+        tasks_[j] = tasks_[j + 1];
+      }
+    } else {
+      i++;
+    }
+  }
+  return numTasks_ > 0;
+}
@@ -0,0 +1,115 @@
+#ifndef _DISPLAY_TASK_H_
+#define _DISPLAY_TASK_H_
+
+#include <cstdint>
+#include "mbed.h"
+
+/**
+ * A resumable driver operation (like init or an e-ink refresh), written as a state machine that
+ * returns from poll() instead of blocking on delays or busy pins, so other work can run meanwhile.
+ */
+class DisplayTask {
+public:
+  // Advances the operation as far as possible without blocking, nowUs the current time in microseconds.
+  // Returns true once the operation is complete (or none was started).
+  virtual bool poll(uint32_t nowUs) = 0;
+
+protected:
+  // Starts a delay of delayUs from nowUs, for poll() to return false through until elapsed
+  void delay(uint32_t nowUs, uint32_t delayUs) {
+    wakeUs_ = nowUs + delayUs;
+    delayArmed_ = true;
+  }
+
+  // Returns whether a started delay has not yet elapsed. The delay is disarmed once seen elapsed, so
+  // a later operation is not compared against a stale wake time (which wraps after 2^31 us, ~36 minutes).
+  bool delaying(uint32_t nowUs) {
+    if (delayArmed_ && (int32_t)(nowUs - wakeUs_) < 0) {  // wraparound-safe
+      return true;
+    }
+    delayArmed_ = false;
+    return false;
+  }
+
+  // Drops any delay in progress, for starting a new operation
+  void cancelDelay() {
+    delayArmed_ = false;
+  }
+
+  // Runs the operation to completion, for the blocking versions of operations
+  void runToCompletion() {
+    Timer timer;
+    timer.start();
+    while (!poll(timer.read_us()));
+  }
+
+  uint32_t wakeUs_ = 0;
+  bool delayArmed_ = false;
+};
+
+/**
+ * Time source for a TaskExecutor, in microseconds.
+ */
+class TaskClock {
+public:
+  virtual uint32_t nowUs() = 0;
+};
+
+// Clock running from an mbed Timer
+class TimerClock : public TaskClock {
+public:
+  TimerClock() {
+    timer_.start();
+  }
+
+  uint32_t nowUs() {
+    return timer_.read_us();
+  }
+
+protected:
+  Timer timer_;
+};
+
+// Clock advanced manually, for running tasks deterministically against virtual time
+class ManualClock : public TaskClock {
+public:
+  uint32_t nowUs() {
+    return nowUs_;
+  }
+
+  void advance(uint32_t us) {
+    nowUs_ += us;
+  }
+
+protected:
+  uint32_t nowUs_ = 0;
+};
+
+/**
+ * Polls a set of running DisplayTasks from the main loop, dropping each once complete.
+ */
+class TaskExecutor {
+public:
+  static const uint8_t kMaxTasks = 4;
+
+  TaskExecutor(TaskClock& clock) :
+      clock_(clock) {
+  }
+
+  // Adds a started task, returning false if kMaxTasks are already running
+  bool add(DisplayTask& task);
+
+  // Polls each running task once. Returns whether any are still running.
+  bool poll();
+
+  bool idle() const {
+    return numTasks_ == 0;
+  }
+
+protected:
+  TaskClock& clock_;
+  DisplayTask* tasks_[kMaxTasks];
+  uint8_t numTasks_ = 0;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _DITHER_H_
+#define _DITHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Ordered (4x4 Bayer) dithering of contrast to the gray levels of a display, for primitives and text.
+ * The thresholds repeat every 4 pixels in x and y, so each row of a span is a repeating byte pattern.
+ */
+class OrderedDither {
+public:
+  // Returns whether a 1bpp pixel is set
+  static bool mono(uint16_t x, uint16_t y, uint8_t contrast) {
+    return contrast > threshold(x, y);
+  }
+
+  // Returns a byte of 8 1bpp pixels (MSB leftmost) of row y, which repeats along the row
+  static uint8_t monoPattern(uint16_t y, uint8_t contrast) {
+    uint8_t pattern = 0;
+    for (uint8_t i=0; i<4; i++) {
+      pattern = (pattern << 1) | (contrast > threshold(i, y) ? 1 : 0);
+    }
+    return pattern * 0x11;
+  }
+
+  // Returns the 4bpp gray level of a pixel, rounded up or down from the truncated level by the threshold
+  static uint8_t gray4(uint16_t x, uint16_t y, uint8_t contrast) {
+    uint16_t scaled = contrast * 15;
+    return scaled / 255 + ((scaled % 255) > threshold(x, y) ? 1 : 0);
+  }
+
+  // Returns the pair of bytes of 4bpp pixels (MsNibble leftmost) of row y, which alternate along the row
+  // starting with even at even byte offsets
+  static void gray4Pattern(uint16_t y, uint8_t contrast, uint8_t& even, uint8_t& odd) {
+    even = (gray4(0, y, contrast) << 4) | gray4(1, y, contrast);
+    odd = (gray4(2, y, contrast) << 4) | gray4(3, y, contrast);
+  }
+
+protected:
+  // Bayer matrix scaled to the middle of each sixteenth of the contrast range
+  static uint8_t threshold(uint16_t x, uint16_t y) {
+    static const uint8_t kThresholds[4][4] = {
+      {  8, 136,  40, 168},
+      {200,  72, 232, 104},
+      { 56, 184,  24, 152},
+      {248, 120, 216,  88},
+    };
+    return kThresholds[y % 4][x % 4];
+  }
+};
+
+/**
+ * Streaming Floyd-Steinberg error diffusion of contrast to the gray levels of a display, for image blits.
+ * Pixels are passed a row at a time, left to right, keeping one row of diffused error, for rows of up
+ * to kMaxWidth pixels.
+ */
+class DiffusionDither {
+public:
+  static const uint16_t kMaxWidth = 256;
+
+  // levels is the number of evenly spaced gray levels the display shows, eg 2 for 1bpp
+  DiffusionDither(uint8_t levels) : step_(255 / (levels - 1)) {
+    memset(errors_, 0, sizeof(errors_));
+    nextRow();
+  }
+
+  // Returns the contrast of the nearest gray level to a pixel, after adding the error diffused to it
+  uint8_t quantize(uint16_t col, uint8_t contrast) {
+    int16_t value = contrast + errors_[col + 1] + right_;
+    value = value < 0 ? 0 : (value > 255 ? 255 : value);
+    uint8_t out = (value + step_ / 2) / step_ * step_;
+    diffuse(col, value - out);
+    return out;
+  }
+
+  // Passes over a pixel that is not drawn (eg, transparent), which takes and diffuses no error
+  void skip(uint16_t col) {
+    diffuse(col, 0);
+  }
+
+  // Starts the next row
+  void nextRow() {
+    right_ = 0;
+    belowRight_ = 0;
+    errors_[0] = 0;  // error diffused below left of the first column is dropped
+  }
+
+protected:
+  // Spreads error 7/16 right, and 3/16, 5/16 and 1/16 below left, below and below right.
+  // errors_ is indexed by col + 1 and holds the current row's error up to col, the next row's after.
+  void diffuse(uint16_t col, int16_t error) {
+    right_ = error * 7 / 16;
+    errors_[col] += error * 3 / 16;
+    errors_[col + 1] = belowRight_ + error * 5 / 16;
+    belowRight_ = error / 16;
+  }
+
+  uint8_t step_;  // contrast between gray levels
+  int16_t right_;
+  int16_t belowRight_;
+  int16_t errors_[kMaxWidth + 2];
+};
+
+#endif
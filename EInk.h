@@ -3,145 +3,541 @@
 
 #include <cassert>
 #include "mbed.h"
+#include "DisplayBus.h"
+#include "DisplayTask.h"
 #include "GraphicsApi.h"
+#include "PackedRow.h"
+#include "RowHashShadow.h"
 
-class EInk152 {
+/**
+ * Driver for UC81xx-class (UC8151 / IL0373) black, white and red e-ink panels of width x height pixels,
+ * with width along the controller's source lines. Frames are 1bpp planes, kStride bytes per row.
+ * When resolutionCmd is nonzero, init sends it with the panel resolution (0x61 on UC8151 / IL0373),
+ * otherwise the controller's default resolution is used.
+ */
+template <uint16_t width, uint16_t height, uint8_t resolutionCmd = 0>
+class EInkUc81xx : public DisplayTask {
 public:
-  EInk152(SPI& spi, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset, DigitalIn& busy) :
-      spi_(spi), cs_(cs), dc_(dc), reset_(reset), busy_(busy) {
+  static_assert(width % 8 == 0, "width must be a whole number of bytes");
+  static_assert(resolutionCmd == 0 || width < 256, "resolution command takes an 8-bit width");
+
+  static const size_t kStride = width / 8;  // bytes per frame row
+  static const size_t kPlaneBytes = kStride * height;  // bytes per frame
+
+  // busy must be on an interrupt-capable pin, it is low while the controller is busy
+  EInkUc81xx(DisplayBus& bus, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset, InterruptIn& busy) :
+      bus_(bus, cs, dc, 10 * 1000 * 1000), reset_(reset), busy_(busy) {
     reset_ = 0;
-    cs_ = 1;
+    busy_.rise(callback(this, &EInkUc81xx::onBusyRelease));
   }
 
-  const uint32_t kBusyTimeoutUs = 100 * 1000;
+  const uint32_t kBusyTimeoutUs = 100 * 1000;  // for power on
+  const uint32_t kRefreshTimeoutUs = 30 * 1000 * 1000;  // for a refresh, which takes seconds
 
-  void init() {
-    cs_ = 0;
-    dc_ = 0;
-    reset_ = 0;
-    wait_us(5 * 1000);
-    reset_ = 1;
-    cs_ = 1;
+  // Sets a function called (from interrupt context) when a refresh completes
+  void onRefreshDone(Callback<void()> refreshDone) {
+    refreshDone_ = refreshDone;
+  }
+
+  // Returns whether a refresh is in progress. The CPU can sleep while this is true, the busy line
+  // interrupt wakes it on completion.
+  bool isRefreshing() const {
+    return refreshing_;
+  }
 
-    command(0x00, (const uint8_t[]){0x0e}, 1);  // soft reset
+  void init() {
+    startInit();
+    runToCompletion();
+  }
 
-  //  eink_command(0x06, (const uint8_t[]){0x17, 0x17, 0x17}, 3);  // booster soft start
-  //  eink_command(0x63, (const uint8_t[]){0x80, 0x01, 0x28}, 3);  // resolution
-  //  eink_command(0x50, (const uint8_t[]){0x87}, 1);  // Vcom / data interval
-    command(0xe0, (const uint8_t[]){0x02}, 1);  // active temperature
-    command(0xe5, (const uint8_t[]){0x19}, 1);  // input temperature: 25c
+  // Starts a non-blocking init, completed through poll() after the reset pulse
+  void startInit() {
+    cancelDelay();
+    step_ = kInitReset;
   }
 
+  /**
+   * Refresh waveforms. Full uses the panel's built-in waveform, driving all three colors over several
+   * seconds with flashing. Fast uses a custom black and white waveform that only drives the pixels that
+   * change, in a fraction of a second, but leaves ghosting that builds up over repeated fast refreshes
+   * until the next full refresh.
+   */
+  enum Quality {
+    Full,
+    Fast,
+  };
+
+  // Sends frames and starts the refresh, returning without waiting for the refresh to complete.
+  // Waits for any refresh in progress first.
   void draw(uint8_t blackFrame[], uint8_t redFrame[]) {
-    Timer busyTimeout;
+    startDraw(blackFrame, redFrame);
+    runUntilRefreshing();
+  }
 
-    if (blackFrame == NULL) {
-      commandConstPayload(0x10, 0x00, 2888);
-    } else {
-      command(0x10, blackFrame, 2888);
-    }
+  // Starts a non-blocking draw, completed through poll() once the refresh completes.
+  // Polls wait for any refresh in progress, send the frames, wait for the controller to power on,
+  // then start the refresh.
+  void startDraw(uint8_t blackFrame[], uint8_t redFrame[]) {
+    blackFrame_ = blackFrame;
+    redFrame_ = redFrame;
+    fast_ = false;
+    cancelDelay();
+    step_ = kDrawStart;
+  }
 
-    if (redFrame == NULL) {
-      commandConstPayload(0x13, 0x00, 2888);
-    } else {
-      command(0x13, redFrame, 2888);
+  // Draws a black and white frame with the Fast waveform, given the frame currently shown,
+  // as draw() returning once the refresh has started
+  void drawFast(const uint8_t oldFrame[], const uint8_t newFrame[]) {
+    startDrawFast(oldFrame, newFrame);
+    runUntilRefreshing();
+  }
+
+  // Starts a non-blocking draw with the Fast waveform, as startDraw()
+  void startDrawFast(const uint8_t oldFrame[], const uint8_t newFrame[]) {
+    blackFrame_ = oldFrame;
+    redFrame_ = newFrame;
+    fast_ = true;
+    cancelDelay();
+    step_ = kDrawStart;
+  }
+
+  // Returns the number of Fast refreshes since the last Full refresh
+  uint16_t getFastRefreshCount() const {
+    return fastRefreshCount_;
+  }
+
+  bool poll(uint32_t nowUs) {
+    if (delaying(nowUs)) {
+      return false;
     }
+    switch (step_) {
+      case kInitReset:
+        reset_ = 0;
+        delay(nowUs, 5 * 1000);
+        step_ = kInitConfigure;
+        return false;
+      case kInitConfigure:
+        reset_ = 1;
+        sendInitSequence();
+        bus_.release();
+        step_ = kIdle;
+        return true;
 
+      case kDrawStart:
+        busyStartUs_ = nowUs;
+        step_ = kDrawSend;
+        // fall through
+      case kDrawSend:
+        if ((busy_ == 0) && ((uint32_t)(nowUs - busyStartUs_) < kRefreshTimeoutUs)) {  // previous refresh in progress
+          return false;
+        }
+        if (fast_) {
+          if (!fastLutLoaded_) {
+            sendFastLuts();
+          }
+          fastRefreshCount_++;
+        } else {
+          if (fastLutLoaded_) {  // soft reset back to the built-in waveform
+            sendInitSequence();
+            fastLutLoaded_ = false;
+          }
+          fastRefreshCount_ = 0;
+        }
+        // in Fast mode these are the old and new frames
+        if (blackFrame_ == NULL) {
+          command(0x10, NULL, 0);
+          bus_.fill(0x00, kPlaneBytes);
+        } else {
+          command(0x10, blackFrame_, kPlaneBytes);
+        }
 
-    // TODO check busy = 0
+        if (redFrame_ == NULL) {
+          command(0x13, NULL, 0);
+          bus_.fill(0x00, kPlaneBytes);
+        } else {
+          command(0x13, redFrame_, kPlaneBytes);
+        }
 
-    command(0x04, NULL, 0);  // power on
-    busyTimeout.start();
-    while ((busy_ == 0) && ((unsigned int)busyTimeout.read_us() < kBusyTimeoutUs));
-//    wait_us(kBusyTimeoutUs);
+        command(0x04, NULL, 0);  // power on
+        bus_.release();
+        busyStartUs_ = nowUs;
+        step_ = kDrawPowerOn;
+        return false;
+      case kDrawPowerOn:
+        if ((busy_ == 0) && ((uint32_t)(nowUs - busyStartUs_) < kBusyTimeoutUs)) {
+          return false;
+        }
+        refreshing_ = true;  // before the command, so the completion edge can't be missed
+        command(0x12, NULL, 0);  // refresh
+        bus_.release();
+        busyStartUs_ = nowUs;
+        step_ = kDrawRefresh;
+        return false;
+      case kDrawRefresh:
+        if (refreshing_ && (uint32_t)(nowUs - busyStartUs_) < kRefreshTimeoutUs) {
+          return false;
+        }
+        refreshing_ = false;
+        step_ = kIdle;
+        return true;
 
-    command(0x12, NULL, 0);  // refresh
-//    while (busy_ == 0);
+      default:
+        return true;
+    }
   }
 
 protected:
+  // Sends a command and its payload in one transaction, which is held open until bus_.release()
   void command(uint8_t index, const uint8_t payload[], size_t len) {
-    spi_.format(8, 0);
-    spi_.frequency(10 * 1000 * 1000);
-    dc_ = 0;
-    cs_ = 0;
-    wait_us(1);
-    spi_.write(index);
-    wait_us(1);
-    dc_ = 1;
-    cs_ = 1;
-    for (size_t i=0; i<len; i++) {
-      wait_us(1);
-      cs_ = 0;
-      wait_us(1);
-      spi_.write(payload[i]);
-      wait_us(1);
-      cs_  = 1;
-    }
-  }
-
-  void commandConstPayload(uint8_t index, uint8_t payloadRepeat, size_t len) {
-    spi_.format(8, 0);
-    spi_.frequency(10 * 1000 * 1000);
-    dc_ = 0;
-    cs_ = 0;
-    wait_us(1);
-    spi_.write(index);
-    wait_us(1);
-    dc_ = 1;
-    cs_ = 1;
-    for (size_t i=0; i<len; i++) {
-      wait_us(1);
-      cs_ = 0;
-      wait_us(1);
-      spi_.write(payloadRepeat);
-      wait_us(1);
-      cs_  = 1;
-    }
-  }
-
-  SPI& spi_;
-  DigitalOut& cs_;
-  DigitalOut& dc_;
+    bus_.command(index, payload, len);
+  }
+
+  // Runs a started draw until the refresh has started
+  void runUntilRefreshing() {
+    Timer timer;
+    timer.start();
+    while (!poll(timer.read_us()) && step_ != kDrawRefresh);
+  }
+
+  // Soft resets the controller's registers and sets up the built-in (Full) waveform
+  void sendInitSequence() {
+    static constexpr uint8_t kInitSequence[] = {
+      0x00, 1, 0x0e,  // soft reset
+    //  0x06, 3, 0x17, 0x17, 0x17,  // booster soft start
+    //  0x50, 1, 0x87,  // Vcom / data interval
+      0xe0, 1, 0x02,  // active temperature
+      0xe5, 1, 0x19,  // input temperature: 25c
+    };
+    bus_.runSequence(kInitSequence, sizeof(kInitSequence));
+    if (resolutionCmd != 0) {
+      const uint8_t resolution[] = {width, height >> 8, height & 0xff};
+      command(resolutionCmd, resolution, sizeof(resolution));
+    }
+  }
+
+  // Switches to the black and white register waveform for Fast refreshes, where the 0x10 and 0x13
+  // frames are the old and new data and each LUT drives one old-to-new pixel transition.
+  // Each LUT group is a level select byte (2 bits per phase), 4 phase frame counts and a repeat count:
+  // a single 25-frame phase, with unchanged pixels held at ground.
+  void sendFastLuts() {
+    static constexpr uint8_t kFastSequence[] = {
+      0x00, 1, 0x3f,  // panel setting: LUT from register, black and white mode
+      0x20, 44, 0x00, 0x19, 0x01, 0x00, 0x00, 0x01,  // VCOM
+          0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0,  0, 0,
+      0x21, 42, 0x00, 0x19, 0x01, 0x00, 0x00, 0x01,  // white to white
+          0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0,
+      0x22, 42, 0x80, 0x19, 0x01, 0x00, 0x00, 0x01,  // black to white
+          0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0,
+      0x23, 42, 0x40, 0x19, 0x01, 0x00, 0x00, 0x01,  // white to black
+          0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0,
+      0x24, 42, 0x00, 0x19, 0x01, 0x00, 0x00, 0x01,  // black to black
+          0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0,
+    };
+    bus_.runSequence(kFastSequence, sizeof(kFastSequence));
+    fastLutLoaded_ = true;
+  }
+
+  DisplayBusDevice bus_;
   DigitalOut& reset_;
-  DigitalIn& busy_;
+  InterruptIn& busy_;
+
+  enum Step {
+    kIdle,
+    kInitReset,
+    kInitConfigure,
+    kDrawStart,
+    kDrawSend,  // waiting for any previous refresh to complete, or timeout
+    kDrawPowerOn,  // waiting for busy to release, or timeout
+    kDrawRefresh,  // waiting for the busy line interrupt, or timeout
+  };
+  Step step_ = kIdle;
+  const uint8_t* blackFrame_;
+  const uint8_t* redFrame_;
+  bool fast_ = false;  // draw with the Fast waveform, blackFrame_ and redFrame_ are the old and new frames
+  bool fastLutLoaded_ = false;
+  uint16_t fastRefreshCount_ = 0;
+  uint32_t busyStartUs_;
+
+  // Busy line rising edge, ending a refresh
+  void onBusyRelease() {
+    if (refreshing_) {
+      refreshing_ = false;
+      if (refreshDone_) {
+        refreshDone_();
+      }
+    }
+  }
+
+  volatile bool refreshing_ = false;
+  Callback<void()> refreshDone_;
 };
 
-class EInk152Graphics : public EInk152, public PixelGraphics {
+// Framebuffer graphics over an EInkUc81xx, hashRows keeping row hashes for setRowHashing (4 bytes per row)
+template <uint16_t width, uint16_t height, uint8_t resolutionCmd = 0, bool hashRows = false>
+class EInkUc81xxGraphics : public EInkUc81xx<width, height, resolutionCmd>, public PixelGraphics {
+  typedef EInkUc81xx<width, height, resolutionCmd> Driver;
+
 public:
-  EInk152Graphics(SPI& spi, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset, DigitalIn& busy) :
-      EInk152(spi, cs, dc, reset, busy) {
+  typedef typename Driver::Quality Quality;
+  using Driver::kStride;
+  using Driver::kPlaneBytes;
+
+  EInkUc81xxGraphics(DisplayBus& bus, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset, InterruptIn& busy) :
+      Driver(bus, cs, dc, reset, busy) {
   }
 
 
+  // Refreshes with the Full waveform, returning once the refresh has started, see isRefreshing().
+  // With row hashing, skipped when no row changed.
   void update() {
-    draw(NULL, frameBuffer_);
+    if (startUpdate()) {
+      this->runUntilRefreshing();
+    }
+  }
+
+  // Starts a non-blocking update, completed through poll(). Returns false if there was nothing to refresh.
+  bool startUpdate() {
+    return frameChanged() && startRefresh(Driver::Full);
+  }
+
+  /**
+   * Refreshes with a choice of waveform, returning once the refresh has started.
+   * Fast refreshes show set pixels as black (there is no red), and after setMaxFastRefreshes
+   * Fast refreshes in a row a Full refresh is done instead to clear the accumulated ghosting.
+   * Fast refreshes need a buffer set with setFastRefreshBuffer, without one they are done Full.
+   */
+  void refresh(Quality quality) {
+    if (startRefresh(quality)) {
+      this->runUntilRefreshing();
+    }
+  }
+
+  // Starts a non-blocking refresh, completed through poll(). With row hashing, Fast refreshes are skipped
+  // (returning false) when no row changed, while Full refreshes are always done, as they clear ghosting.
+  bool startRefresh(Quality quality) {
+    if (!frameChanged() && quality == Driver::Fast) {
+      return false;
+    }
+    if (quality == Driver::Fast && !shownFrameValid_) {  // no record of the frame shown, the old data
+      quality = Driver::Full;
+    }
+    if (quality == Driver::Fast && maxFastRefreshes_ != 0 && this->getFastRefreshCount() >= maxFastRefreshes_) {
+      quality = Driver::Full;
+    }
+    if (quality == Driver::Fast) {
+      this->startDrawFast(shownFrame_, frameBuffer_);
+    } else {
+      this->startDraw(NULL, frameBuffer_);
+    }
+    return true;
+  }
+
+  // Sets a buffer of kPlaneBytes to keep a copy of the last frame sent in, the old data Fast refreshes need,
+  // or NULL to free it for other use (so refreshes are done Full). The next refresh is Full, to fill it.
+  void setFastRefreshBuffer(uint8_t* shownFrame) {
+    shownFrame_ = shownFrame;
+    shownFrameValid_ = false;
+  }
+
+  // Sets the number of Fast refreshes after which a Full refresh is forced, 0 to never force one
+  void setMaxFastRefreshes(uint16_t maxFastRefreshes) {
+    maxFastRefreshes_ = maxFastRefreshes;
+  }
+
+  bool poll(uint32_t nowUs) {
+    bool sending = this->step_ == Driver::kDrawStart || this->step_ == Driver::kDrawSend;
+    bool done = Driver::poll(nowUs);
+    if (sending && this->step_ == Driver::kDrawPowerOn && shownFrame_ != NULL) {
+      memcpy(shownFrame_, frameBuffer_, kPlaneBytes);  // frames sent, record what the panel now shows
+      shownFrameValid_ = true;
+    }
+    return done;
+  }
+
+  // When enabled, update() and Fast refreshes skip the (multi-second) refresh when no row was drawn to
+  // since the last update. With hashRows, rows drawn to but hashing the same as last sent do not count,
+  // costing a hash of each row drawn to per update.
+  void setRowHashing(bool enable) {
+    rowHashing_ = enable;
+    rowHashes_.invalidate();
   }
 
   uint16_t getWidth() {
-    return 152;
+    return width;
   }
   uint16_t getHeight() {
-    return 152;
+    return height;
   }
 
 
   void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) {
-    if ((x >= 152) || (y >= 152)) {  // out of bounds
+    if ((x >= width) || (y >= height)) {  // out of bounds
       return;
     }
-    uint8_t* bufferByte = frameBuffer_ + (y * (152/8) + (x / 8));
+    uint8_t* bufferByte = frameBuffer_ + (y * kStride + (x / 8));
     uint8_t bufferBitMask = 1 << (7 - (x%8));
-    if (contrast < 127) {
+    if (dithers(contrast) ? !OrderedDither::mono(x, y, contrast) : !Mono1Format::fromContrast(contrast)) {
       *bufferByte = *bufferByte & ~bufferBitMask;
     } else {
       *bufferByte = *bufferByte | bufferBitMask;
     }
+    rowHashes_.touch(y);
+  }
+
+  // Only the red plane is driven, so red is drawn set and other colors as their contrast would be
+  void drawPixel(uint16_t x, uint16_t y, Color color) {
+    drawPixel(x, y, toContrast(color));
+  }
+
+  // Span kernels: whole bytes in a row, or a bit mask walking down the stride
+  void drawHSpan(uint16_t x, uint16_t y, uint16_t w, uint8_t contrast) {
+    uint8_t fill = dithers(contrast) ? OrderedDither::monoPattern(y, contrast) : (Mono1Format::fromContrast(contrast) ? 0xff : 0x00);
+    PackedRow::fillBits(frameBuffer_ + y * kStride, x, w, fill);
+    rowHashes_.touch(y);
+  }
+  void drawHSpan(uint16_t x, uint16_t y, uint16_t w, Color color) {
+    drawHSpan(x, y, w, toContrast(color));
+  }
+
+  void drawVSpan(uint16_t x, uint16_t y, uint16_t h, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawVSpanPixels(x, y, h, contrast);
+      return;
+    }
+    PackedColumn::fill(frameBuffer_ + y * kStride + x / 8, kStride, 0x80 >> (x % 8), h,
+        Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y, y + h - 1);
+  }
+  void drawVSpan(uint16_t x, uint16_t y, uint16_t h, Color color) {
+    drawVSpan(x, y, h, toContrast(color));
+  }
+
+  void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawGlyphColumnPixels(x, y, glyph, h, contrast);
+      return;
+    }
+    PackedColumn::drawGlyph(frameBuffer_ + y * kStride + x / 8, kStride, 0x80 >> (x % 8), glyph, h,
+        Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawGlyphRowPixels(x, y, glyph, w, contrast);
+      return;
+    }
+    PackedRow::drawBits(frameBuffer_ + y * kStride, x, glyph, w, Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y);
+  }
+  void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, Color color) {
+    drawGlyphColumn(x, y, glyph, h, toContrast(color));
+  }
+  void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, Color color) {
+    drawGlyphRow(x, y, glyph, w, toContrast(color));
+  }
+
+  // Copies rows directly for 1bpp bitmaps at byte-aligned x without transparency,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::MONO_1BPP || bitmap.hasTransparency() || (x % 8) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if ((x >= width) || (y >= height)) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    for (uint16_t row=0; row<h; row++) {
+      const uint8_t* src = bitmap.getRow(row);
+      uint8_t* dst = frameBuffer_ + ((y + row) * kStride + (x / 8));
+      memcpy(dst, src, w / 8);
+      if (w % 8 != 0) {  // partial trailing byte
+        uint8_t mask = 0xff << (8 - (w % 8));
+        dst[w / 8] = (dst[w / 8] & ~mask) | (src[w / 8] & mask);
+      }
+    }
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  // Decodes 1bpp images at byte-aligned x directly into the framebuffer,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::MONO_1BPP || (x % 8) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if ((x >= width) || (y >= height)) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      uint8_t* dst = frameBuffer_ + ((y + row) * kStride + (x / 8));
+      decoder.read(dst, w / 8);
+      if (w % 8 != 0) {  // partial trailing byte
+        uint8_t mask = 0xff << (8 - (w % 8));
+        dst[w / 8] = (dst[w / 8] & ~mask) | (decoder.next() & mask);
+      }
+      decoder.skip(bitmap.getStride() - (w + 7) / 8);
+    }
+    rowHashes_.touch(y, y + h - 1);
   }
 
 
+  // Copies rows as bit streams, a memmove per row when srcX and dstX have the same alignment in a byte
+  void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) {
+    if (!clipCopyRect(srcX, srcY, w, h, dstX, dstY)) {
+      return;
+    }
+    for (uint16_t i=0; i<h; i++) {
+      uint16_t row = (dstY > srcY) ? h - 1 - i : i;  // copy away from the overlap
+      PackedRow::copyBits(frameBuffer_ + (dstY + row) * kStride, dstX,
+          frameBuffer_ + (srcY + row) * kStride, srcX, w, kStride);
+    }
+    rowHashes_.touch(dstY, dstY + h - 1);
+  }
+
 protected:
-  uint8_t frameBuffer_[2888] = {0};
+  uint8_t getGrayLevels() {
+    return 2;
+  }
+
+  static uint8_t toContrast(Color color) {
+    return TriColorFormat::fromColor(color) == TriColorFormat::kRed ? 255 : color.toContrast();
+  }
+
+  // Returns whether the framebuffer may differ from what was last drawn. The panel refreshes as a whole,
+  // so with row hashing the transfer and refresh are skipped when no row changed.
+  bool frameChanged() {
+    if (!rowHashing_) {
+      return true;
+    }
+    bool changed = false;
+    rowHashes_.forEachChangedRun(frameBuffer_, kStride, [&changed](uint16_t, uint16_t) {
+      changed = true;
+    });
+    return changed;
+  }
+
+  uint8_t frameBuffer_[kPlaneBytes] = {0};
+  uint8_t* shownFrame_ = NULL;  // last frame sent, the old data of Fast refreshes, if a buffer is set
+  bool shownFrameValid_ = false;
+  uint16_t maxFastRefreshes_ = 0;
+
+  bool rowHashing_ = false;
+  RowHashShadow<height, hashRows> rowHashes_;
 };
 
+// 1.54" 152x152 black, white and red panel, at the controller's default resolution
+typedef EInkUc81xx<152, 152> EInk152;
+typedef EInkUc81xxGraphics<152, 152> EInk152Graphics;
+
 #endif
@@ -3,58 +3,584 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
 #include <utility>
 #include <stdlib.h>
 
+#include "Color.h"
+#include "Dither.h"
+
 // TODO font
 class GraphicsFont {
 public:
+  /**
+   * Layouts of character bit data. Column-major stores each column top to bottom as bytes of 8 rows,
+   * least significant bit topmost. Row-major stores each row as bytes of 8 columns, most significant
+   * bit leftmost (as MONO_1BPP bitmaps), which row-major framebuffers draw a row at a time.
+   * Gray rows store 4 bits of coverage per pixel (see GrayFont), drawn antialiased by 4bpp backends.
+   */
+  enum GlyphLayout {
+    kColumnMajor,
+    kRowMajor,
+    kGrayRows,
+  };
+
   virtual uint8_t getFontHeight() = 0;  // return the font height, in pixels
 
   virtual const uint8_t* getCharData(char in) = 0;  // returns a pointer to the character bit data
   virtual uint8_t getCharWidth(char in) = 0;  // returns the width of the character, in pixels
-};
 
-class GeneratorFont : public GraphicsFont {
-public:
-  GeneratorFont(const uint8_t** charData, const uint8_t* charWidths, uint8_t height, uint8_t maxWidth) :
-    charData_(charData), charWidths_(charWidths), height_(height), maxWidth_(maxWidth) {
+  virtual GlyphLayout getGlyphLayout() {  // returns the layout of the character bit data
+    return kColumnMajor;
   }
 
-  uint8_t getFontHeight() {
-    return height_;
+  // Returns the bit data and width of a Unicode character, by default of ASCII characters only
+  virtual const uint8_t* getGlyphData(uint32_t codepoint) {
+    return codepoint < 0x80 ? getCharData(codepoint) : NULL;
+  }
+  virtual uint8_t getGlyphWidth(uint32_t codepoint) {
+    return codepoint < 0x80 ? getCharWidth(codepoint) : 0;
   }
 
-  const uint8_t* getCharData(char in) {
+  // Returns the width, in pixels, of up to len bytes of a UTF-8 string (stopping at its terminator) as
+  // text() draws it: characters without bit data are skipped, the others are separated by a pixel
+  virtual uint16_t measure(const char* string, size_t len = SIZE_MAX) {
+    uint16_t width = 0;
+    uint16_t count = 0;
+    for (const char* start = string; (size_t)(string - start) < len && *string != 0; ) {
+      const uint8_t* charData;
+      uint8_t charWidth;
+      nextGlyph(string, charData, charWidth);
+      if (charData != NULL) {
+        width += charWidth;
+        count++;
+      }
+    }
+    return count > 0 ? width + count - 1 : 0;
+  }
+
+  // Looks up the bit data and width of the next character of a UTF-8 string, advancing past it.
+  // ASCII characters are looked up directly, without decoding.
+  void nextGlyph(const char*& string, const uint8_t*& charData, uint8_t& charWidth) {
+    if ((uint8_t)*string < 0x80) {
+      charData = getCharData(*string);
+      charWidth = getCharWidth(*string);
+      string++;
+    } else {
+      uint32_t codepoint = decodeUtf8(string);
+      charData = getGlyphData(codepoint);
+      charWidth = getGlyphWidth(codepoint);
+    }
+  }
+
+  // Decodes the next character of a UTF-8 string, advancing past it.
+  // Malformed sequences decode as U+FFFD, advancing a byte.
+  static uint32_t decodeUtf8(const char*& string) {
+    const uint8_t* bytes = (const uint8_t*)string;
+    uint32_t codepoint;
+    uint8_t continuations;
+    if (bytes[0] < 0x80) {
+      string++;
+      return bytes[0];
+    } else if ((bytes[0] & 0xe0) == 0xc0) {
+      codepoint = bytes[0] & 0x1f;
+      continuations = 1;
+    } else if ((bytes[0] & 0xf0) == 0xe0) {
+      codepoint = bytes[0] & 0x0f;
+      continuations = 2;
+    } else if ((bytes[0] & 0xf8) == 0xf0) {
+      codepoint = bytes[0] & 0x07;
+      continuations = 3;
+    } else {
+      string++;
+      return 0xfffd;
+    }
+    for (uint8_t i=1; i<=continuations; i++) {
+      if ((bytes[i] & 0xc0) != 0x80) {  // also stops at the terminator
+        string++;
+        return 0xfffd;
+      }
+      codepoint = (codepoint << 6) | (bytes[i] & 0x3f);
+    }
+    string += 1 + continuations;
+    return codepoint;
+  }
+};
+
+/**
+ * Per-character bit data and width tables of a generated font, for characters 32 to 126,
+ * where characters the font does not have are NULL.
+ */
+class FontTable {
+public:
+  FontTable(const uint8_t** charData, const uint8_t* charWidths) :
+    charData_(charData), charWidths_(charWidths), monoWidth_(findMonoWidth(charData, charWidths)) {
+  }
+
+  const uint8_t* getCharData(char in) const {
     if (in < 32 || in > 126) {
       return NULL;
     }
     return charData_[in - 32];
   }
-  uint8_t getCharWidth(char in) {
+  uint8_t getCharWidth(char in) const {
     if (in < 32 || in > 126) {
       return 0;
     }
     return charWidths_[in - 32];
   }
 
-private:
+  // As GraphicsFont::measure, without virtual calls. Monospace fonts only count the characters
+  // and multiply, proportional fonts sum the width table.
+  uint16_t measure(const char* string, size_t len) const {
+    uint16_t width = 0;
+    uint16_t count = 0;
+    if (monoWidth_ != 0) {
+      for (size_t i=0; i<len && string[i] != 0; i++) {
+        count += getCharData(string[i]) != NULL;
+      }
+      width = count * monoWidth_;
+    } else {
+      for (size_t i=0; i<len && string[i] != 0; i++) {
+        if (getCharData(string[i]) != NULL) {
+          width += charWidths_[string[i] - 32];
+          count++;
+        }
+      }
+    }
+    return count > 0 ? width + count - 1 : 0;
+  }
+
+protected:
+  // Returns the width shared by every character the font has, or 0 if they differ
+  static uint8_t findMonoWidth(const uint8_t** charData, const uint8_t* charWidths) {
+    uint8_t monoWidth = 0;
+    for (uint8_t i=0; i<=126-32; i++) {
+      if (charData[i] == NULL) {
+        continue;
+      }
+      if (monoWidth != 0 && charWidths[i] != monoWidth) {
+        return 0;
+      }
+      monoWidth = charWidths[i];
+    }
+    return monoWidth;
+  }
+
   const uint8_t** const charData_;
   const uint8_t* const charWidths_;
+  const uint8_t monoWidth_;  // 0 for proportional fonts
+};
+
+class GeneratorFont : public GraphicsFont {
+public:
+  GeneratorFont(const uint8_t** charData, const uint8_t* charWidths, uint8_t height, uint8_t maxWidth,
+      GlyphLayout layout = kColumnMajor) :
+    table_(charData, charWidths), height_(height), maxWidth_(maxWidth), layout_(layout) {
+  }
+
+  uint8_t getFontHeight() {
+    return height_;
+  }
+
+  const uint8_t* getCharData(char in) {
+    return table_.getCharData(in);
+  }
+  uint8_t getCharWidth(char in) {
+    return table_.getCharWidth(in);
+  }
+
+  GlyphLayout getGlyphLayout() {
+    return layout_;
+  }
+
+  uint16_t measure(const char* string, size_t len = SIZE_MAX) {
+    return table_.measure(string, len);
+  }
+
+private:
+  const FontTable table_;
   const uint8_t height_;
   const uint8_t maxWidth_;
+  const GlyphLayout layout_;
+};
+
+/**
+ * Font of any set of Unicode characters, such as Latin-1 and a few symbols, or a subset of another font.
+ * Glyph bit data and widths are tables indexed by glyph number. Dense ranges of characters map to
+ * consecutive glyphs, and are checked in order (so ASCII should come first), then the remaining
+ * characters are binary searched in a table sorted by character.
+ */
+class RangeFont : public GraphicsFont {
+public:
+  struct Range {
+    uint32_t first;  // first character
+    uint16_t count;  // number of characters
+    uint16_t glyph;  // glyph number of the first character
+  };
+
+  struct SparseGlyph {
+    uint32_t codepoint;
+    uint16_t glyph;
+  };
+
+  RangeFont(const Range* ranges, uint8_t rangeCount, const SparseGlyph* sparse, uint16_t sparseCount,
+      const uint8_t** glyphData, const uint8_t* glyphWidths, uint8_t height, uint8_t maxWidth,
+      GlyphLayout layout = kColumnMajor) :
+    ranges_(ranges), sparse_(sparse), glyphData_(glyphData), glyphWidths_(glyphWidths),
+    rangeCount_(rangeCount), sparseCount_(sparseCount), height_(height), maxWidth_(maxWidth), layout_(layout) {
+  }
+
+  uint8_t getFontHeight() {
+    return height_;
+  }
+
+  const uint8_t* getCharData(char in) {
+    int32_t glyph = (uint8_t)in < 0x80 ? findGlyph((uint8_t)in) : -1;
+    return glyph < 0 ? NULL : glyphData_[glyph];
+  }
+  uint8_t getCharWidth(char in) {
+    int32_t glyph = (uint8_t)in < 0x80 ? findGlyph((uint8_t)in) : -1;
+    return glyph < 0 ? 0 : glyphWidths_[glyph];
+  }
+
+  const uint8_t* getGlyphData(uint32_t codepoint) {
+    int32_t glyph = findGlyph(codepoint);
+    return glyph < 0 ? NULL : glyphData_[glyph];
+  }
+  uint8_t getGlyphWidth(uint32_t codepoint) {
+    int32_t glyph = findGlyph(codepoint);
+    return glyph < 0 ? 0 : glyphWidths_[glyph];
+  }
+
+  GlyphLayout getGlyphLayout() {
+    return layout_;
+  }
+
+  // As GraphicsFont::measure, with a lookup per character instead of virtual calls
+  uint16_t measure(const char* string, size_t len = SIZE_MAX) {
+    uint16_t width = 0;
+    uint16_t count = 0;
+    for (const char* start = string; (size_t)(string - start) < len && *string != 0; ) {
+      int32_t glyph = findGlyph(decodeUtf8(string));
+      if (glyph >= 0 && glyphData_[glyph] != NULL) {
+        width += glyphWidths_[glyph];
+        count++;
+      }
+    }
+    return count > 0 ? width + count - 1 : 0;
+  }
+
+protected:
+  // Returns the glyph number of a character, or -1 if the font does not have it
+  int32_t findGlyph(uint32_t codepoint) const {
+    for (uint8_t i=0; i<rangeCount_; i++) {
+      if (codepoint - ranges_[i].first < ranges_[i].count) {  // wraps for characters before first
+        return ranges_[i].glyph + (codepoint - ranges_[i].first);
+      }
+    }
+    uint16_t low = 0;
+    uint16_t high = sparseCount_;
+    while (low < high) {
+      uint16_t mid = (low + high) / 2;
+      if (sparse_[mid].codepoint < codepoint) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return (low < sparseCount_ && sparse_[low].codepoint == codepoint) ? sparse_[low].glyph : -1;
+  }
+
+  const Range* const ranges_;
+  const SparseGlyph* const sparse_;
+  const uint8_t** const glyphData_;
+  const uint8_t* const glyphWidths_;
+  const uint8_t rangeCount_;
+  const uint16_t sparseCount_;
+  const uint8_t height_;
+  const uint8_t maxWidth_;
+  const GlyphLayout layout_;
+};
+
+/**
+ * Antialiased font with 4 bits of coverage per pixel, 15 fully covered. Each character is stored as
+ * rows of GRAY_4BPP pixels (2 per byte, MsNibble leftmost, rows starting on a byte boundary), so rows
+ * can be blended straight into a 4bpp framebuffer. Generated from TrueType fonts by tools/grayfont.py.
+ * Backends without gray levels draw the pixels at least half covered.
+ */
+class GrayFont : public GraphicsFont {
+public:
+  GrayFont(const uint8_t** charData, const uint8_t* charWidths, uint8_t height, uint8_t maxWidth) :
+    table_(charData, charWidths), height_(height), maxWidth_(maxWidth) {
+  }
+
+  uint8_t getFontHeight() {
+    return height_;
+  }
+
+  const uint8_t* getCharData(char in) {
+    return table_.getCharData(in);
+  }
+  uint8_t getCharWidth(char in) {
+    return table_.getCharWidth(in);
+  }
+
+  GlyphLayout getGlyphLayout() {
+    return kGrayRows;
+  }
+
+  uint16_t measure(const char* string, size_t len = SIZE_MAX) {
+    return table_.measure(string, len);
+  }
+
+  // Returns the bytes per row of character data of a width
+  static size_t getStride(uint8_t charWidth) {
+    return (charWidth + 1) / 2;
+  }
+
+private:
+  const FontTable table_;
+  const uint8_t height_;
+  const uint8_t maxWidth_;
+};
+
+/**
+ * Bitmap image stored row-major in one of the framebuffer-native pixel formats, so blits to a
+ * display with the same format can copy whole rows.
+ * Rows start on a byte boundary (in RGB444, on a pixel pair boundary).
+ */
+class Bitmap {
+public:
+  enum Format {
+    MONO_1BPP,  // 8 pixels per byte, MSB leftmost, set bits are highest contrast
+    GRAY_4BPP,  // 2 pixels per byte, MsNibble leftmost
+    RGB_444,  // 2 pixels per 3 bytes, as (R0 G0) (B0 R1) (G1 B1)
+  };
+
+  static const int32_t kNoTransparency = -1;
+
+  // transparentKey is a native pixel value (eg, 0-15 for GRAY_4BPP) that is not drawn
+  Bitmap(Format format, uint16_t width, uint16_t height, const uint8_t* data,
+      int32_t transparentKey = kNoTransparency) :
+      format_(format), width_(width), height_(height), data_(data), transparentKey_(transparentKey) {
+  }
+
+  Format getFormat() const {
+    return format_;
+  }
+  uint16_t getWidth() const {
+    return width_;
+  }
+  uint16_t getHeight() const {
+    return height_;
+  }
+  bool hasTransparency() const {
+    return transparentKey_ != kNoTransparency;
+  }
+  int32_t getTransparentKey() const {
+    return transparentKey_;
+  }
+
+  // Returns the number of bytes per row
+  size_t getStride() const {
+    switch (format_) {
+      case MONO_1BPP: return (width_ + 7) / 8;
+      case GRAY_4BPP: return (width_ + 1) / 2;
+      default: return (width_ + 1) / 2 * 3;
+    }
+  }
+
+  const uint8_t* getRow(uint16_t y) const {
+    return data_ + y * getStride();
+  }
+
+  // Returns the native pixel value at some location
+  uint16_t getPixel(uint16_t x, uint16_t y) const {
+    const uint8_t* row = getRow(y);
+    switch (format_) {
+      case MONO_1BPP:
+        return (row[x / 8] >> (7 - (x % 8))) & 0x01;
+      case GRAY_4BPP:
+        return (x % 2 == 0) ? (row[x / 2] >> 4) : (row[x / 2] & 0x0f);
+      default:
+        row += x / 2 * 3;
+        if (x % 2 == 0) {
+          return ((uint16_t)row[0] << 4) | (row[1] >> 4);
+        } else {
+          return ((uint16_t)(row[1] & 0x0f) << 8) | row[2];
+        }
+    }
+  }
+
+  // Converts a native pixel value to monochrome contrast, averaging color components
+  uint8_t toContrast(uint16_t pixel) const {
+    switch (format_) {
+      case MONO_1BPP:
+        return pixel ? 255 : 0;
+      case GRAY_4BPP:
+        return pixel * 17;
+      default:
+        return ((pixel >> 8) + ((pixel >> 4) & 0x0f) + (pixel & 0x0f)) * 17 / 3;
+    }
+  }
+
+  // Converts a native pixel value to a Color
+  Color toColor(uint16_t pixel) const {
+    if (format_ == RGB_444) {
+      return Color((pixel >> 8) * 17, ((pixel >> 4) & 0x0f) * 17, (pixel & 0x0f) * 17);
+    }
+    uint8_t contrast = toContrast(pixel);
+    return Color(contrast, contrast, contrast);
+  }
+
+protected:
+  const Format format_;
+  const uint16_t width_, height_;
+  const uint8_t* const data_;
+  const int32_t transparentKey_;
+};
+
+/**
+ * Bitmap image compressed with PackBits run-length encoding over its packed row bytes
+ * (same formats and row layout as Bitmap), decoded as a stream so it can be drawn without
+ * an intermediate buffer.
+ * Generated from images by tools/img2packbits.py.
+ */
+class CompressedBitmap {
+public:
+  CompressedBitmap(Bitmap::Format format, uint16_t width, uint16_t height, const uint8_t* data) :
+      format_(format), width_(width), height_(height), data_(data) {
+  }
+
+  Bitmap::Format getFormat() const {
+    return format_;
+  }
+  uint16_t getWidth() const {
+    return width_;
+  }
+  uint16_t getHeight() const {
+    return height_;
+  }
+  const uint8_t* getData() const {
+    return data_;
+  }
+
+  // Returns the number of decoded bytes per row
+  size_t getStride() const {
+    return Bitmap(format_, width_, 1, NULL).getStride();
+  }
+
+protected:
+  const Bitmap::Format format_;
+  const uint16_t width_, height_;
+  const uint8_t* const data_;
+};
+
+/**
+ * Streaming PackBits decoder.
+ * Each run starts with a signed header byte n: 0 to 127 is followed by n+1 literal bytes,
+ * -1 to -127 is followed by one byte repeated 1-n times, and -128 is ignored.
+ */
+class PackBitsDecoder {
+public:
+  PackBitsDecoder(const uint8_t* data) : data_(data) {
+  }
+
+  // Returns the next decoded byte
+  uint8_t next() {
+    if (remaining_ == 0) {
+      nextRun();
+    }
+    remaining_--;
+    return literal_ ? *data_++ : repeat_;
+  }
+
+  // Decodes the next len bytes into out, a run at a time
+  void read(uint8_t* out, size_t len) {
+    while (len > 0) {
+      if (remaining_ == 0) {
+        nextRun();
+      }
+      size_t count = std::min<size_t>(len, remaining_);
+      if (literal_) {
+        memcpy(out, data_, count);
+        data_ += count;
+      } else {
+        memset(out, repeat_, count);
+      }
+      out += count;
+      len -= count;
+      remaining_ -= count;
+    }
+  }
+
+  // Passes the next len decoded bytes to a sink without copying them, a run at a time: literal runs
+  // as sink.data(bytes, count) straight from the compressed data, repeat runs as sink.fill(byte, count)
+  template <typename Sink>
+  void stream(Sink& sink, size_t len) {
+    while (len > 0) {
+      if (remaining_ == 0) {
+        nextRun();
+      }
+      size_t count = std::min<size_t>(len, remaining_);
+      if (literal_) {
+        sink.data(data_, count);
+        data_ += count;
+      } else {
+        sink.fill(repeat_, count);
+      }
+      len -= count;
+      remaining_ -= count;
+    }
+  }
+
+  // Discards the next len decoded bytes
+  void skip(size_t len) {
+    while (len > 0) {
+      if (remaining_ == 0) {
+        nextRun();
+      }
+      size_t count = std::min<size_t>(len, remaining_);
+      if (literal_) {
+        data_ += count;
+      }
+      len -= count;
+      remaining_ -= count;
+    }
+  }
+
+protected:
+  void nextRun() {
+    int8_t header;
+    do {
+      header = (int8_t)*data_++;
+    } while (header == -128);
+    if (header >= 0) {
+      literal_ = true;
+      remaining_ = header + 1;
+    } else {
+      literal_ = false;
+      remaining_ = 1 - header;
+      repeat_ = *data_++;
+    }
+  }
+
+  const uint8_t* data_;
+  uint8_t remaining_ = 0;  // bytes left in the current run
+  bool literal_ = false;
+  uint8_t repeat_ = 0;
 };
 
 /**
  * Simple API for graphical displays, supporting color, monochrome, and one-bit displays.
  *
- * TODO: color display API
- *
  * Conventions:
  * Color is an optional argument on functions:
  * - if not specified: it defaults to the highest contrast color
  * - if specified as 8-bit int: used as the monochrome contrast, with 0 being lowest and 255 being highest
- * - if specified as a color: TODO
+ * - if specified as a Color: used directly on color displays, converted to the display's native format
  * - colors are quantized as necessary, and colors are converted to monochrome by averaging the R, G, B components
  * Coordinates are defined with (0, 0) being the top left, increasing downwards and rightwards
  * - operations that exceed these bounds wrap
@@ -81,7 +607,12 @@ public:
    */
   // Clears the framebuffer
   virtual void clear() {
-    rectFilled(0, 0, getWidth() - 1, getHeight() - 1, 0);
+    rectFilled(0, 0, getWidth(), getHeight(), 0);
+  }
+
+  // Fills the framebuffer with a color
+  virtual void clear(Color color) {
+    rectFilled(0, 0, getWidth(), getHeight(), color);
   }
 
   // Draw a rectangle, coordinates are inclusive
@@ -89,18 +620,21 @@ public:
     rect(x, y, w, h, 255);
   }
   virtual void rect(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast) = 0;
+  virtual void rect(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) = 0;
 
   // Draw a filled rectangle, coordinates are inclusive
   void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h) {
     rectFilled(x, y, w, h, 255);
   }
   virtual void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast) = 0;
+  virtual void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) = 0;
 
   // Draw a line, using a fast line algorithm
   void line(uint16_t x, uint16_t y, int16_t w, int16_t h) {
     line(x, y, w, h, 255);
   }
   virtual void line(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast) = 0;
+  virtual void line(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) = 0;
 
   // Draws text (null-terminated string), the specified location is the top left of the text drawn
   // Returns the horizontal size, in pixels, of the text drawn
@@ -108,13 +642,275 @@ public:
     return text(x, y, string, font, 255);
   }
   virtual uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t contrast) = 0;
+  virtual uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, Color color) = 0;
+
+  // Draws a bitmap image with its top left at the specified location, clipped to the display.
+  // Pixels matching the bitmap's transparent key are not drawn.
+  virtual void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) = 0;
+
+  // Draws a compressed bitmap image with its top left at the specified location, clipped to the display.
+  virtual void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) = 0;
+
+  /**
+   * Framebuffer region operations
+   */
+  // Copies a w*h region with top left at (srcX, srcY) to (dstX, dstY), clipped to the display.
+  // The source and destination may overlap.
+  virtual void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) = 0;
 
-  // TODO: bitmapped image operations
+  // Scrolls the contents of a w*h region with top left at (x, y) by (dx, dy) pixels,
+  // filling the exposed area with fillContrast. Contents scrolled outside the region are discarded.
+  virtual void scrollRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, int16_t dx, int16_t dy,
+      uint8_t fillContrast = 0) {
+    if (abs(dx) >= w || abs(dy) >= h) {
+      rectFilled(x, y, w, h, fillContrast);
+      return;
+    }
+    copyRect(dx >= 0 ? x : x - dx, dy >= 0 ? y : y - dy, w - abs(dx), h - abs(dy),
+        dx >= 0 ? x + dx : x, dy >= 0 ? y + dy : y);
+    if (dx > 0) {
+      rectFilled(x, y, dx, h, fillContrast);
+    } else if (dx < 0) {
+      rectFilled(x + w + dx, y, -dx, h, fillContrast);
+    }
+    if (dy > 0) {
+      rectFilled(x, y, w, dy, fillContrast);
+    } else if (dy < 0) {
+      rectFilled(x, y + h + dy, w, -dy, fillContrast);
+    }
+  }
 };
 
 class PixelGraphics : public GraphicsApi {
 public:
   void rect(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast = 255) {
+    rectImpl(x, y, w, h, contrast);
+  }
+  void rect(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) {
+    rectImpl(x, y, w, h, color);
+  }
+
+  void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast = 255) {
+    rectFilledImpl(x, y, w, h, contrast);
+  }
+  void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) {
+    rectFilledImpl(x, y, w, h, color);
+  }
+
+  void line(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast = 255) {
+    lineImpl(x, y, w, h, contrast);
+  }
+  void line(uint16_t x, uint16_t y, int16_t w, int16_t h, Color color) {
+    lineImpl(x, y, w, h, color);
+  }
+
+  uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t contrast = 255) {
+    return textImpl(x, y, string, font, contrast);
+  }
+  uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, Color color) {
+    return textImpl(x, y, string, font, color);
+  }
+
+  /**
+   * Sets whether gray contrasts are dithered to the gray levels of the display, instead of being
+   * rounded to the nearest (or truncated) on backends with few levels. Primitives and text are ordered
+   * dithered, a repeating pattern cheap enough for fills, and grayscale image blits are error
+   * diffused, which renders detail and gradients better at a per-pixel cost.
+   */
+  void setDithering(bool enable) {
+    dithering_ = enable;
+  }
+
+  // Generic blit that converts each pixel to contrast (or color for RGB444),
+  // backends provide faster paths for their native format
+  void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) {
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), x < getWidth() ? getWidth() - x : 0);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), y < getHeight() ? getHeight() - y : 0);
+    if (diffuses(bitmap.getFormat(), w)) {
+      blitDiffused(x, y, w, h, bitmap);
+      return;
+    }
+    for (uint16_t row=0; row<h; row++) {
+      for (uint16_t col=0; col<w; col++) {
+        uint16_t pixel = bitmap.getPixel(col, row);
+        if (bitmap.hasTransparency() && pixel == bitmap.getTransparentKey()) {
+          continue;
+        }
+        if (bitmap.getFormat() == Bitmap::RGB_444) {
+          drawPixel(x + col, y + row, bitmap.toColor(pixel));
+        } else {
+          drawPixel(x + col, y + row, bitmap.toContrast(pixel));
+        }
+      }
+    }
+  }
+
+  // Generic compressed blit that decodes a byte group at a time and converts each pixel to contrast
+  // (or color for RGB444), backends decode directly into their framebuffer when possible
+  void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), x < getWidth() ? getWidth() - x : 0);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), y < getHeight() ? getHeight() - y : 0);
+    if (diffuses(bitmap.getFormat(), w)) {
+      blitDiffused(x, y, w, h, bitmap);
+      return;
+    }
+    // smallest whole-byte unit of pixels: one byte for 1bpp and 4bpp, a 3-byte pixel pair for RGB444
+    uint8_t groupBytes = bitmap.getFormat() == Bitmap::RGB_444 ? 3 : 1;
+    uint8_t groupPixels = bitmap.getFormat() == Bitmap::MONO_1BPP ? 8 : 2;
+    uint8_t group[3];
+    Bitmap groupBitmap(bitmap.getFormat(), groupPixels, 1, group);
+
+    size_t stride = bitmap.getStride();
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      size_t rowBytes = 0;
+      for (uint16_t col=0; col<w; col+=groupPixels) {
+        decoder.read(group, groupBytes);
+        rowBytes += groupBytes;
+        for (uint8_t i=0; i<groupPixels && col+i<w; i++) {
+          uint16_t pixel = groupBitmap.getPixel(i, 0);
+          if (bitmap.getFormat() == Bitmap::RGB_444) {
+            drawPixel(x + col + i, y + row, groupBitmap.toColor(pixel));
+          } else {
+            drawPixel(x + col + i, y + row, groupBitmap.toContrast(pixel));
+          }
+        }
+      }
+      decoder.skip(stride - rowBytes);
+    }
+  }
+
+protected:
+  // Returns the number of evenly spaced gray levels the display shows, which dithering quantizes to,
+  // or 0 if it does not dither (eg, color displays)
+  virtual uint8_t getGrayLevels() {
+    return 0;
+  }
+
+  // Returns whether a contrast is drawn dithered, that is dithering is on and it is a gray
+  bool dithers(uint8_t contrast) {
+    return dithering_ && contrast != 0 && contrast != 255;
+  }
+
+  // Returns whether blits of a format are error diffused
+  bool diffuses(Bitmap::Format format, uint16_t w) {
+    return dithering_ && format == Bitmap::GRAY_4BPP && getGrayLevels() > 0 && w <= DiffusionDither::kMaxWidth;
+  }
+
+  // Blits w x h pixels of a grayscale bitmap, clipped to the display, error diffused to its gray levels
+  void blitDiffused(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const Bitmap& bitmap) {
+    DiffusionDither dither(getGrayLevels());
+    for (uint16_t row=0; row<h; row++) {
+      for (uint16_t col=0; col<w; col++) {
+        uint16_t pixel = bitmap.getPixel(col, row);
+        if (bitmap.hasTransparency() && pixel == bitmap.getTransparentKey()) {
+          dither.skip(col);
+        } else {
+          drawPixel(x + col, y + row, dither.quantize(col, bitmap.toContrast(pixel)));
+        }
+      }
+      dither.nextRow();
+    }
+  }
+
+  // As above, decoding a 4bpp pixel pair at a time (only GRAY_4BPP is diffused, see diffuses())
+  void blitDiffused(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const CompressedBitmap& bitmap) {
+    DiffusionDither dither(getGrayLevels());
+    uint8_t group;  // 4bpp pixel pair
+    Bitmap groupBitmap(bitmap.getFormat(), 2, 1, &group);
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      for (uint16_t col=0; col<w; col+=2) {
+        group = decoder.next();
+        for (uint8_t i=0; i<2 && col+i<w; i++) {
+          drawPixel(x + col + i, y + row, dither.quantize(col + i, groupBitmap.toContrast(groupBitmap.getPixel(i, 0))));
+        }
+      }
+      decoder.skip(bitmap.getStride() - (w + 1) / 2);
+      dither.nextRow();
+    }
+  }
+
+  virtual void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) = 0;
+
+  // Draws a colored pixel, by default as its contrast. This is a runtime conversion for gray and mono
+  // backends, color backends override it with their native format.
+  virtual void drawPixel(uint16_t x, uint16_t y, Color color) {
+    drawPixel(x, y, color.toContrast());
+  }
+
+  // Drawing kernels the primitives are built from, with coordinates already clipped to the display.
+  // These default to a drawPixel per pixel, backends override them with framebuffer-native loops.
+
+  // Draws w pixels rightwards from (x, y)
+  virtual void drawHSpan(uint16_t x, uint16_t y, uint16_t w, uint8_t contrast) {
+    drawHSpanPixels(x, y, w, contrast);
+  }
+  virtual void drawHSpan(uint16_t x, uint16_t y, uint16_t w, Color color) {
+    drawHSpanPixels(x, y, w, color);
+  }
+
+  // Draws h pixels downwards from (x, y)
+  virtual void drawVSpan(uint16_t x, uint16_t y, uint16_t h, uint8_t contrast) {
+    drawVSpanPixels(x, y, h, contrast);
+  }
+  virtual void drawVSpan(uint16_t x, uint16_t y, uint16_t h, Color color) {
+    drawVSpanPixels(x, y, h, color);
+  }
+
+  // Draws the set pixels of the top h rows of a font glyph column downwards from (x, y),
+  // where glyph holds the column as bytes of 8 rows, least significant bit topmost
+  virtual void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, uint8_t contrast) {
+    drawGlyphColumnPixels(x, y, glyph, h, contrast);
+  }
+  virtual void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, Color color) {
+    drawGlyphColumnPixels(x, y, glyph, h, color);
+  }
+
+  // Draws the set pixels of the leftmost w columns of a font glyph row rightwards from (x, y),
+  // where glyph holds the row as bytes of 8 columns, most significant bit leftmost
+  virtual void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, uint8_t contrast) {
+    drawGlyphRowPixels(x, y, glyph, w, contrast);
+  }
+  virtual void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, Color color) {
+    drawGlyphRowPixels(x, y, glyph, w, color);
+  }
+
+  template <typename PixelValue>
+  void drawHSpanPixels(uint16_t x, uint16_t y, uint16_t w, PixelValue contrast) {
+    for (uint16_t i=0; i<w; i++) {
+      drawPixel(x + i, y, contrast);
+    }
+  }
+
+  template <typename PixelValue>
+  void drawVSpanPixels(uint16_t x, uint16_t y, uint16_t h, PixelValue contrast) {
+    for (uint16_t i=0; i<h; i++) {
+      drawPixel(x, y + i, contrast);
+    }
+  }
+
+  template <typename PixelValue>
+  void drawGlyphColumnPixels(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, PixelValue contrast) {
+    for (uint8_t row=0; row<h; row++) {
+      if (glyph[row / 8] & (1 << (row % 8))) {
+        drawPixel(x, y + row, contrast);
+      }
+    }
+  }
+
+  template <typename PixelValue>
+  void drawGlyphRowPixels(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, PixelValue contrast) {
+    for (uint8_t col=0; col<w; col++) {
+      if (glyph[col / 8] & (0x80 >> (col % 8))) {
+        drawPixel(x + col, y, contrast);
+      }
+    }
+  }
+
+  // Primitives, templated on the pixel value type (contrast or Color) passed through to drawPixel
+  template <typename PixelValue>
+  void rectImpl(uint16_t x, uint16_t y, int16_t w, int16_t h, PixelValue contrast) {
     uint16_t x2 = x + w;
     uint16_t y2 = y + h;
     if (x2 < x) {
@@ -124,20 +920,30 @@ public:
       std::swap(y, y2);
     }
 
-    for (uint16_t xPos=x; xPos<x2; xPos++) {
-      drawPixel(xPos, y, contrast);
-      drawPixel(xPos, y2, contrast);
+    // horizontal edges exclude x2 and vertical edges y2, clipped to the display
+    uint16_t spanW = std::min(x2, getWidth()) - std::min(x, getWidth());
+    uint16_t spanH = std::min(y2, getHeight()) - std::min(y, getHeight());
+    if (spanW > 0) {
+      if (y < getHeight()) {
+        drawHSpan(x, y, spanW, contrast);
+      }
+      if (y2 < getHeight()) {
+        drawHSpan(x, y2, spanW, contrast);
+      }
     }
 
-    if ((y2 - y) > 1) {
-      for (uint16_t yPos=y; yPos<y2; yPos++) {
-        drawPixel(x, yPos, contrast);
-        drawPixel(x2, yPos, contrast);
+    if ((y2 - y) > 1 && spanH > 0) {
+      if (x < getWidth()) {
+        drawVSpan(x, y, spanH, contrast);
+      }
+      if (x2 < getWidth()) {
+        drawVSpan(x2, y, spanH, contrast);
       }
     }
   }
 
-  void rectFilled(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast = 255) {
+  template <typename PixelValue>
+  void rectFilledImpl(uint16_t x, uint16_t y, int16_t w, int16_t h, PixelValue contrast) {
     uint16_t x2 = x + w;
     uint16_t y2 = y + h;
     if (x2 < x) {
@@ -147,20 +953,36 @@ public:
       std::swap(y, y2);
     }
 
+    x2 = std::min(x2, getWidth());
+    y2 = std::min(y2, getHeight());
+    if (x >= x2) {
+      return;
+    }
     for (uint16_t yPos=y; yPos<y2; yPos++) {
-      for (uint16_t xPos=x; xPos<x2; xPos++) {
-        drawPixel(xPos, yPos, contrast);
-      }
+      drawHSpan(x, yPos, x2 - x, contrast);
     }
   }
 
-  void line(uint16_t x, uint16_t y, int16_t w, int16_t h, uint8_t contrast = 255) {
+  template <typename PixelValue>
+  void lineImpl(uint16_t x, uint16_t y, int16_t w, int16_t h, PixelValue contrast) {
     int16_t dx = abs(w);
     int16_t dy = abs(h);
 
     int16_t xIncr = w < 0? -1 : 1;
     int16_t yIncr = h < 0? -1 : 1;
 
+    if (h == 0 || w == 0) {  // axis-aligned, as a span from the lower end
+      int32_t start = (h == 0 ? x : y) + (w + h < 0 ? w + h + 1 : 0);
+      int32_t end = std::min<int32_t>(start + dx + dy, h == 0 ? getWidth() : getHeight());
+      start = std::max<int32_t>(start, 0);
+      if (h == 0 && y < getHeight() && start < end) {
+        drawHSpan(start, y, end - start, contrast);
+      } else if (w == 0 && x < getWidth() && start < end) {
+        drawVSpan(x, start, end - start, contrast);
+      }
+      return;
+    }
+
     if (dx >= dy) {
       // in x-major
       int16_t d = 2 * dy - dx;
@@ -190,39 +1012,122 @@ public:
     }
   }
 
-  uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t contrast = 255) {
+  template <typename PixelValue>
+  uint16_t textImpl(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, PixelValue contrast) {
     uint16_t origx = x;
-    for (; *string != 0; string++) {
-      const uint8_t* charData = font.getCharData(*string) - 1;
-      uint8_t charWidth = font.getCharWidth(*string);
+    uint8_t columnBytes = (font.getFontHeight() + 7) / 8;
+    uint8_t drawHeight = y < getHeight() ? std::min<uint16_t>(font.getFontHeight(), getHeight() - y) : 0;
+    if (drawHeight == 0 && x < getWidth()) {  // nothing visible, skip the glyph data
+      return std::min<uint16_t>(font.measure(string), getWidth() - x);
+    }
+    if (font.getGlyphLayout() == GraphicsFont::kRowMajor) {
+      return textRowsImpl(x, y, string, font, drawHeight, contrast);
+    }
+    if (font.getGlyphLayout() == GraphicsFont::kGrayRows) {
+      return textGrayImpl(x, y, string, font, drawHeight, contrast);
+    }
+    while (*string != 0) {
+      const uint8_t* charData;
+      uint8_t charWidth;
+      font.nextGlyph(string, charData, charWidth);
       if (charData != NULL) {
         for (uint8_t col=0; col<charWidth; col++) {
           if (x >= getWidth()) {
             return getWidth() - origx;
           }
-
-          for (uint8_t row=0; row<font.getFontHeight(); row++) {
-            uint8_t bitPos = row % 8;
-            if (bitPos == 0) {
-              charData++;
-            }
-            if (*charData & (1 << bitPos)) {
-              if (y + row < getHeight()) {
-                drawPixel(x, y + row, contrast);
-              }
-            }
+          if (drawHeight > 0) {
+            drawGlyphColumn(x, y, charData, drawHeight, contrast);
           }
-
+          charData += columnBytes;
           x++;
         }
         x++;  // inter-character space
       }
     }
-    return x - origx - 1;  // don't count the trailing space
+    return x > origx ? x - origx - 1 : 0;  // don't count the trailing space
   }
 
-protected:
-  virtual void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) = 0;
+  // Draws text in a row-major font a glyph row at a time, drawHeight being the font height clipped to
+  // the display, otherwise as textImpl
+  template <typename PixelValue>
+  uint16_t textRowsImpl(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t drawHeight,
+      PixelValue contrast) {
+    uint16_t origx = x;
+    while (*string != 0) {
+      const uint8_t* charData;
+      uint8_t charWidth;
+      font.nextGlyph(string, charData, charWidth);
+      if (charData == NULL) {
+        continue;
+      }
+      if (x >= getWidth() && charWidth > 0) {
+        return getWidth() - origx;
+      }
+      uint8_t drawWidth = std::min<uint16_t>(charWidth, getWidth() - x);
+      uint8_t rowBytes = (charWidth + 7) / 8;
+      for (uint8_t row=0; row<drawHeight; row++) {
+        drawGlyphRow(x, y + row, charData + row * rowBytes, drawWidth, contrast);
+      }
+      if (drawWidth < charWidth) {
+        return getWidth() - origx;
+      }
+      x += charWidth + 1;  // inter-character space
+    }
+    return x > origx ? x - origx - 1 : 0;  // don't count the trailing space
+  }
+
+  // Draws text in a gray font as spans of the pixels at least half covered, for backends without gray
+  // levels to blend into, otherwise as textRowsImpl
+  template <typename PixelValue>
+  uint16_t textGrayImpl(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t drawHeight,
+      PixelValue contrast) {
+    uint16_t origx = x;
+    while (*string != 0) {
+      const uint8_t* charData;
+      uint8_t charWidth;
+      font.nextGlyph(string, charData, charWidth);
+      if (charData == NULL) {
+        continue;
+      }
+      if (x >= getWidth() && charWidth > 0) {
+        return getWidth() - origx;
+      }
+      uint8_t drawWidth = std::min<uint16_t>(charWidth, getWidth() - x);
+      for (uint8_t row=0; row<drawHeight; row++) {
+        const uint8_t* coverage = charData + row * GrayFont::getStride(charWidth);
+        uint8_t col = 0;
+        while (col < drawWidth) {
+          uint8_t spanStart = col;
+          while (col < drawWidth && ((col % 2 == 0) ? coverage[col / 2] >> 4 : coverage[col / 2] & 0x0f) >= 8) {
+            col++;
+          }
+          if (col > spanStart) {
+            drawHSpan(x + spanStart, y + row, col - spanStart, contrast);
+          } else {
+            col++;
+          }
+        }
+      }
+      if (drawWidth < charWidth) {
+        return getWidth() - origx;
+      }
+      x += charWidth + 1;  // inter-character space
+    }
+    return x > origx ? x - origx - 1 : 0;  // don't count the trailing space
+  }
+
+  // Clips a copyRect region so both the source and destination lie on the display,
+  // returning false if nothing is left to copy
+  bool clipCopyRect(uint16_t srcX, uint16_t srcY, uint16_t& w, uint16_t& h, uint16_t dstX, uint16_t dstY) {
+    if (srcX >= getWidth() || dstX >= getWidth() || srcY >= getHeight() || dstY >= getHeight()) {
+      return false;
+    }
+    w = std::min<uint16_t>(w, getWidth() - std::max(srcX, dstX));
+    h = std::min<uint16_t>(h, getHeight() - std::max(srcY, dstY));
+    return w > 0 && h > 0;
+  }
+
+  bool dithering_ = false;
 };
 
 #endif
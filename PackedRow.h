@@ -0,0 +1,179 @@
+#ifndef _PACKED_ROW_H_
+#define _PACKED_ROW_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Operations on framebuffer rows as packed bit streams, most significant bit leftmost.
+ * Covers every backend format: 1bpp, 4bpp gray and RGB444 pixels are 1, 4 and 12 bits wide.
+ */
+class PackedRow {
+public:
+  /**
+   * Copies count bits from srcBit in srcRow to dstBit in dstRow, where the source and destination
+   * may overlap. Bits outside the destination range are preserved.
+   * When source and destination have the same alignment within a byte this is a memmove,
+   * otherwise each destination byte is assembled from two shifted source bytes.
+   * rowBytes is the length of the source row, which is not read past.
+   */
+  static void copyBits(uint8_t* dstRow, uint32_t dstBit, const uint8_t* srcRow, uint32_t srcBit,
+      uint32_t count, size_t rowBytes) {
+    if (count == 0) {
+      return;
+    }
+    uint8_t* dst = dstRow + dstBit / 8;
+    uint8_t dstShift = dstBit % 8;
+    size_t dstBytes = (dstShift + count + 7) / 8;
+    uint8_t firstMask = 0xff >> dstShift;  // bits written in the first and last destination bytes
+    uint8_t lastMask = 0xff << ((8 - (dstShift + count) % 8) % 8);
+    if (dstBytes == 1) {
+      firstMask &= lastMask;
+      lastMask = firstMask;
+    }
+
+    if (srcBit % 8 == dstShift) {
+      uint8_t first = dst[0], last = dst[dstBytes - 1];
+      memmove(dst, srcRow + srcBit / 8, dstBytes);
+      dst[0] = (dst[0] & firstMask) | (first & ~firstMask);
+      dst[dstBytes - 1] = (dst[dstBytes - 1] & lastMask) | (last & ~lastMask);
+      return;
+    }
+
+    // walk away from the overlap so each source byte is read before it is overwritten
+    bool forward = (dst < srcRow + srcBit / 8) || (dst == srcRow + srcBit / 8 && dstShift < srcBit % 8);
+    for (size_t i=0; i<dstBytes; i++) {
+      size_t j = forward ? i : dstBytes - 1 - i;
+      int32_t srcPos = (int32_t)srcBit - dstShift + 8 * (int32_t)j;  // source bit of the destination byte MSB
+      int32_t srcByte = (srcPos + 8) / 8 - 1;  // floor, srcPos may be slightly negative
+      uint8_t shift = (srcPos + 8) % 8;
+      uint8_t hi = (srcByte >= 0) ? srcRow[srcByte] : 0;
+      uint8_t lo = ((size_t)(srcByte + 1) < rowBytes) ? srcRow[srcByte + 1] : 0;
+      uint8_t value = (hi << shift) | (lo >> (8 - shift));
+
+      uint8_t mask = 0xff;
+      if (j == 0) {
+        mask &= firstMask;
+      }
+      if (j == dstBytes - 1) {
+        mask &= lastMask;
+      }
+      dst[j] = (value & mask) | (dst[j] & ~mask);
+    }
+  }
+
+  /**
+   * Sets count bits from bit in row to the corresponding bits of fill, a byte pattern repeating every
+   * byte (0x00 or 0xff for 1bpp, a doubled pixel for 4bpp). The partial bytes at either end are masked
+   * and the whole bytes between are a memset.
+   */
+  static void fillBits(uint8_t* row, uint32_t bit, uint32_t count, uint8_t fill) {
+    if (count == 0) {
+      return;
+    }
+    uint8_t* dst = row + bit / 8;
+    uint8_t shift = bit % 8;
+    size_t bytes = (shift + count + 7) / 8;
+    uint8_t firstMask = 0xff >> shift;
+    uint8_t lastMask = 0xff << ((8 - (shift + count) % 8) % 8);
+    if (bytes == 1) {
+      firstMask &= lastMask;
+      dst[0] = (fill & firstMask) | (dst[0] & ~firstMask);
+      return;
+    }
+    dst[0] = (fill & firstMask) | (dst[0] & ~firstMask);
+    memset(dst + 1, fill, bytes - 2);
+    dst[bytes - 1] = (fill & lastMask) | (dst[bytes - 1] & ~lastMask);
+  }
+
+  // Sets (or clears) the bits of dstRow from dstBit where the first count bits of src are set, leaving
+  // the others, as for a row of a 1bpp glyph. Each source byte is shifted into two destination bytes.
+  static void drawBits(uint8_t* dstRow, uint32_t dstBit, const uint8_t* src, uint32_t count, bool set) {
+    uint8_t* dst = dstRow + dstBit / 8;
+    uint8_t shift = dstBit % 8;
+    for (uint32_t i=0; i<count; i+=8, src++, dst++) {
+      uint8_t bits = *src;
+      if (count - i < 8) {
+        bits &= 0xff << (8 - (count - i));
+      }
+      uint8_t hi = bits >> shift;
+      uint8_t lo = shift ? bits << (8 - shift) : 0;  // only nonzero within the row
+      if (set) {
+        dst[0] |= hi;
+        if (lo) {
+          dst[1] |= lo;
+        }
+      } else {
+        dst[0] &= ~hi;
+        if (lo) {
+          dst[1] &= ~lo;
+        }
+      }
+    }
+  }
+
+  // Sets count bits from bit in row to a pattern of two bytes alternating along the row, evenFill at
+  // even byte offsets, as for a dither pattern of 4bpp pixels
+  static void fillBits(uint8_t* row, uint32_t bit, uint32_t count, uint8_t evenFill, uint8_t oddFill) {
+    if (count == 0) {
+      return;
+    }
+    size_t first = bit / 8;
+    size_t last = (bit + count - 1) / 8;
+    for (size_t i=first; i<=last; i++) {
+      uint8_t mask = 0xff;
+      if (i == first) {
+        mask &= 0xff >> (bit % 8);
+      }
+      if (i == last) {
+        mask &= 0xff << (7 - (bit + count - 1) % 8);
+      }
+      uint8_t fill = (i % 2 == 0) ? evenFill : oddFill;
+      row[i] = (fill & mask) | (row[i] & ~mask);
+    }
+  }
+};
+
+/**
+ * Operations on one pixel column of a 1bpp framebuffer of packed rows, where the column is a fixed
+ * bit mask in a byte that walks down by the row stride.
+ */
+class PackedColumn {
+public:
+  // Sets (or clears) count pixels down from the masked bit of top
+  static void fill(uint8_t* top, size_t stride, uint8_t mask, uint16_t count, bool set) {
+    if (set) {
+      for (uint16_t i=0; i<count; i++, top+=stride) {
+        *top |= mask;
+      }
+    } else {
+      for (uint16_t i=0; i<count; i++, top+=stride) {
+        *top &= ~mask;
+      }
+    }
+  }
+
+  /**
+   * Sets (or clears) the pixels of a glyph column down from the masked bit of top, where glyph holds
+   * the column as bytes of 8 rows, least significant bit topmost. Only the first count rows are drawn,
+   * and a byte's rows are skipped as a whole when none of its bits are set.
+   */
+  static void drawGlyph(uint8_t* top, size_t stride, uint8_t mask, const uint8_t* glyph, uint16_t count,
+      bool set) {
+    uint8_t fill = set ? mask : 0;
+    for (uint16_t row=0; row<count; row+=8) {
+      uint8_t bits = *glyph++;
+      if (count - row < 8) {
+        bits &= (1 << (count - row)) - 1;
+      }
+      for (uint8_t* dst=top + row*stride; bits; bits>>=1, dst+=stride) {
+        if (bits & 1) {
+          *dst = (*dst & ~mask) | fill;
+        }
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef _ROW_HASH_SHADOW_H_
+#define _ROW_HASH_SHADOW_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Per-row checksum of what was last transmitted from a framebuffer, so update() can skip rows
+ * that have not changed since the previous update.
+ *
+ * Rows are marked as touched when drawn to, and only touched rows are re-hashed on update.
+ * A touched row whose contents hash the same as what was last sent (for example, a widget
+ * redrawing the same value) is not resent.
+ * Without kHashed, the 4 bytes per row of hashes are not allocated and every touched row is resent.
+ */
+template <uint16_t kRows, bool kHashed = true>
+class RowHashShadow {
+public:
+  RowHashShadow() {
+    invalidate();
+  }
+
+  // Marks a row as possibly modified since the last update
+  void touch(uint16_t row) {
+    touched_[row / 32] |= (uint32_t)1 << (row % 32);
+  }
+
+  // Marks an inclusive range of rows as possibly modified since the last update
+  void touch(uint16_t rowStart, uint16_t rowEnd) {
+    rowEnd = rowEnd < kRows ? rowEnd : kRows - 1;
+    for (uint16_t row=rowStart; row<=rowEnd; ) {  // a masked word at a time
+      uint16_t last = (row | 31) < rowEnd ? (row | 31) : rowEnd;
+      touched_[row / 32] |= (0xffffffff >> (31 - (last - row))) << (row % 32);
+      row = last + 1;
+    }
+  }
+
+  void touchAll() {
+    for (size_t i=0; i<kWords; i++) {
+      touched_[i] = 0xffffffff;
+    }
+  }
+
+  // Forgets what was last transmitted for a row, so the next update resends it
+  void forget(uint16_t row) {
+    touch(row);
+    known_[row / 32] &= ~((uint32_t)1 << (row % 32));
+  }
+
+  // Forgets what was last transmitted, so the next update resends every row
+  void invalidate() {
+    touchAll();
+    for (size_t i=0; i<kWords; i++) {
+      known_[i] = 0;
+    }
+  }
+
+  // Re-hashes a touched row and returns whether its contents differ from what was last sent,
+  // recording the new hash as sent. Untouched rows are reported unchanged without hashing.
+  bool rowChanged(uint16_t row, const uint8_t* data, size_t len) {
+    uint32_t bit = (uint32_t)1 << (row % 32);
+    if (!(touched_[row / 32] & bit)) {
+      return false;
+    }
+    touched_[row / 32] &= ~bit;
+    if (!kHashed) {
+      return true;
+    }
+
+    uint32_t hash = hashRow(data, len);
+    if ((known_[row / 32] & bit) && hashes_[row] == hash) {
+      return false;
+    }
+    known_[row / 32] |= bit;
+    hashes_[row] = hash;
+    return true;
+  }
+
+  // Calls sendRows(rowStart, rowEnd) with each inclusive run of consecutive changed rows of a
+  // framebuffer with the specified row stride, in bytes.
+  template <typename F>
+  void forEachChangedRun(const uint8_t* framebuffer, size_t stride, F sendRows) {
+    uint16_t row = 0;
+    while (row < kRows) {
+      if (!rowChanged(row, framebuffer + row * stride, stride)) {
+        row++;
+        continue;
+      }
+      uint16_t rowStart = row;
+      row++;
+      while (row < kRows && rowChanged(row, framebuffer + row * stride, stride)) {
+        row++;
+      }
+      sendRows(rowStart, row - 1);
+    }
+  }
+
+protected:
+  // 32-bit FNV-1a, a multiply and xor per byte
+  static uint32_t hashRow(const uint8_t* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<len; i++) {
+      hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+  }
+
+  static const size_t kWords = (kRows + 31) / 32;
+
+  uint32_t touched_[kWords];  // bitmap of rows drawn to since the last update
+  uint32_t known_[kWords];  // bitmap of rows with a valid transmitted hash
+  uint32_t hashes_[kHashed ? kRows : 1];
+};
+
+/**
+ * Set of framebuffer rows, taken out as runs of consecutive rows, for updates sent a piece at a time.
+ */
+template <uint16_t kRows>
+class RowSet {
+public:
+  RowSet() {
+    clear();
+  }
+
+  void add(uint16_t row) {
+    rows_[row / 32] |= (uint32_t)1 << (row % 32);
+  }
+
+  // Adds an inclusive range of rows
+  void add(uint16_t rowStart, uint16_t rowEnd) {
+    for (uint16_t row=rowStart; row<=rowEnd && row<kRows; row++) {
+      add(row);
+    }
+  }
+
+  void addAll() {
+    add(0, kRows - 1);
+  }
+
+  void clear() {
+    for (size_t i=0; i<kWords; i++) {
+      rows_[i] = 0;
+    }
+  }
+
+  bool empty() const {
+    for (size_t i=0; i<kWords; i++) {
+      if (rows_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Removes the first run of consecutive rows in the set, at most maxRows long, returning its
+  // inclusive bounds. Returns false if the set is empty.
+  bool takeRun(uint16_t maxRows, uint16_t& rowStart, uint16_t& rowEnd) {
+    rowStart = 0;
+    while (rowStart < kRows && !contains(rowStart)) {
+      rowStart++;
+    }
+    if (rowStart >= kRows) {
+      return false;
+    }
+    rowEnd = rowStart;
+    while (rowEnd + 1 < kRows && rowEnd + 1 - rowStart < maxRows && contains(rowEnd + 1)) {
+      rowEnd++;
+    }
+    for (uint16_t row=rowStart; row<=rowEnd; row++) {
+      rows_[row / 32] &= ~((uint32_t)1 << (row % 32));
+    }
+    return true;
+  }
+
+protected:
+  bool contains(uint16_t row) const {
+    return rows_[row / 32] & ((uint32_t)1 << (row % 32));
+  }
+
+  static const size_t kWords = (kRows + 31) / 32;
+
+  uint32_t rows_[kWords];
+};
+
+#endif
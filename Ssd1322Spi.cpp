@@ -1,70 +1,69 @@
 #include "Ssd1322Spi.h"
 
-void Ssd1322Spi::init() {
-  spi_.frequency(10000000);
+void Ssd1322Spi::init(uint8_t height, uint8_t colOffset) {
+  startInit(height, colOffset);
+  runToCompletion();
+}
 
-  reset_ = 1;
+void Ssd1322Spi::startInit(uint8_t height, uint8_t colOffset) {
+  colOffset_ = colOffset;
+  initHeight_ = height;
+  initPending_ = true;
+}
+
+bool Ssd1322Spi::poll(uint32_t) {  // the sequence has no waits, so needs no time
+  // power-on sequence, split around the panel-dependent multiplex ratio
+  static constexpr uint8_t kInitSequenceStart[] = {
+    Command::SET_COMMAND_LOCK, 1, 0x12,
+    Command::DISPLAY_OFF, 0,
+    Command::SET_DISPLAY_CLOCK, 1, 0x91,
+  };
+  static constexpr uint8_t kInitSequenceEnd[] = {
+    Command::SET_DISPLAY_OFFSET, 1, 0x00,
+    Command::SET_DISPLAY_START_LINE, 1, 0x00,
+    Command::SET_REMAP, 2, 0x14, 0x00,
+
+    Command::SET_GPIO, 1, 0x00,
+    Command::FUNCTION_SELECTION, 1, 0x01,
+
+    Command::DISPLAY_ENHANCEMENT_A, 2, 0xA0, 0xFD,
+
+    Command::SET_CONSTRAST_CONTROL, 3, 0xFF, 0xFF, 0xFF,
+    Command::MASTER_CONSTRAST_CONTROL, 1, 0x0F,
+
+    Command::SELECT_DEFAULT_LINEAR_GRAYSCALE_TABLE, 0,
 
-  cs_ = 0;
+    Command::SET_PHASE_LENGTH, 1, 0xE2,
+    Command::SET_PRECHARGE_VOLTAGE, 1, 0x1F,
+    Command::SET_SECOND_PRECHARGE_PERIOD, 1, 0x08,
+    Command::SET_VCOMH_VOLTAGE, 1, 0x07,
 
-  command(Command::SET_COMMAND_LOCK);
-  data(0x12);
+    Command::DISPLAY_MODE_NORMAL, 0,
+    Command::DISPLAY_ON, 0,
+  };
 
-  command(Command::DISPLAY_OFF);
+  if (!initPending_) {
+    return true;
+  }
 
-  command(Command::SET_DISPLAY_CLOCK);
-  data(0x91);
+  reset_ = 1;
+
+  bus_.runSequence(kInitSequenceStart, sizeof(kInitSequenceStart));
   command(Command::SET_MULTIPLEX_RATIO);
-  data(0x3F);
-  command(Command::SET_DISPLAY_OFFSET);
-  data(0x00);
-  command(Command::SET_DISPLAY_START_LINE);
-  data(0x00);
-  command(Command::SET_REMAP);
-  data(0x14);
-  data(0x00);
-
-  command(Command::SET_GPIO);
-  data(0x00);
-  command(Command::FUNCTION_SELECTION);
-  data(0x01);
-
-  command(Command::DISPLAY_ENHANCEMENT_A);
-  data(0xA0);
-  data(0xFD);
-
-  command(Command::SET_CONSTRAST_CONTROL);
-  data(0xFF);
-  data(0xFF);
-  data(0xFF);
-  command(Command::MASTER_CONSTRAST_CONTROL);
-  data(0x0F);
-
-  command(Command::SELECT_DEFAULT_LINEAR_GRAYSCALE_TABLE);
-
-  command(Command::SET_PHASE_LENGTH);
-  data(0xE2);
-  command(Command::SET_PRECHARGE_VOLTAGE);
-  data(0x1F);
-  command(Command::SET_SECOND_PRECHARGE_PERIOD);
-  data(0x08);
-  command(Command::SET_VCOMH_VOLTAGE);
-  data(0x07);
-
-  command(Command::DISPLAY_MODE_NORMAL);
-  command(Command::DISPLAY_ON);
-
-  cs_ = 1;
+  data(initHeight_ - 1);
+  bus_.runSequence(kInitSequenceEnd, sizeof(kInitSequenceEnd));
+
+  bus_.release();
+  initPending_ = false;
+  return true;
 }
 
 void Ssd1322Spi::beginWrite(uint8_t col_start, uint8_t col_end, uint8_t row_start, uint8_t row_end) {
-  assert(row_end < 64);
-
-  cs_ = 0;
+  assert(row_end < kRamRows);
 
   command(Command::SET_COLUMN_ADDRESS);
-  data(0x1c + col_start/4);
-  data(0x1c + col_end/4);
+  data(colOffset_ + col_start/4);
+  data(colOffset_ + col_end/4);
   command(Command::SET_ROW_ADDRESS);
   data(row_start);
   data(row_end);
@@ -73,17 +72,20 @@ void Ssd1322Spi::beginWrite(uint8_t col_start, uint8_t col_end, uint8_t row_star
 }
 
 void Ssd1322Spi::endWrite() {
-  cs_ = 1;
+  bus_.release();
+}
+
+void Ssd1322Spi::setStartLine(uint8_t line) {
+  command(Command::SET_DISPLAY_START_LINE);
+  data(line);
+  bus_.release();
 }
 
 void Ssd1322Spi::command(uint8_t payload) {
-  dc_ = 0;
-  // technically, there should be a 15ns delay here
-  spi_.write(payload);
+  // technically, there should be a 15ns delay between DC and data
+  bus_.command(payload);
 }
 
 void Ssd1322Spi::data(uint8_t payload) {
-  dc_ = 1;
-  // technically, there should be a 15ns delay here
-  spi_.write(payload);
+  bus_.data(payload);
 }
@@ -3,25 +3,36 @@
 
 #include <cassert>
 #include "mbed.h"
+#include "DisplayBus.h"
+#include "DisplayTask.h"
 
-class Ssd1322Spi {
+class Ssd1322Spi : public DisplayTask {
 public:
-  Ssd1322Spi(SPI& spi, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset) :
-      spi_(spi), cs_(cs), dc_(dc), reset_(reset) {
+  Ssd1322Spi(DisplayBus& bus, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset) :
+      bus_(bus, cs, dc, 10000000), reset_(reset), colOffset_(0x1c) {
     reset_ = 0;
-    cs_ = 1;
   }
 
   /**
-   * Initialize the display. Call before any other commands.
+   * Initialize the display for a panel with the specified number of rows, and the display RAM column
+   * address (in 4-pixel units) of its leftmost column. Call before any other commands.
    */
-  void init();
+  void init(uint8_t height = 64, uint8_t colOffset = 0x1c);
+
+  // Starts a non-blocking init, completed by the next poll(). The sequence itself has no waits,
+  // this allows running it under a TaskExecutor alongside other displays' init.
+  void startInit(uint8_t height = 64, uint8_t colOffset = 0x1c);
+
+  bool poll(uint32_t nowUs);
+
+  static const uint8_t kRamRows = 128;  // rows of display RAM
 
   /**
    * Begins a write to the display RAM, specifying the boundaries at which columns
    * and rows wrap around.
-   * col_start and col_end must be divisible by 4, otherwise will truncate.
-   * Call writeTwoPixels after this to stream data to the display.
+   * col_start and col_end are in pixels relative to the panel's leftmost column, and must be
+   * divisible by 4, otherwise will truncate.
+   * Stream pixel data to the display with bus_.data after this.
    * Holds the CS line asserted until endWrite() is called.
    */
   void beginWrite(uint8_t col_start, uint8_t col_end, uint8_t row_start, uint8_t row_end);
@@ -31,6 +42,11 @@ public:
    */
   void endWrite();
 
+  /**
+   * Sets the display RAM row shown at the top of the display, from 0 to 127.
+   */
+  void setStartLine(uint8_t line);
+
 protected:
   // Send a command byte
   void command(uint8_t payload);
@@ -38,11 +54,14 @@ protected:
   // Send a data byte
   void data(uint8_t payload);
 
-  SPI& spi_;
-  DigitalOut& cs_;
-  DigitalOut& dc_;
+  DisplayBusDevice bus_;
   DigitalOut& reset_;
 
+  uint8_t colOffset_;
+
+  bool initPending_ = false;
+  uint8_t initHeight_;
+
   enum Command {
     SET_COLUMN_ADDRESS = 0x15,
     WRITE_RAM = 0x5C,
@@ -1,47 +1,431 @@
 #ifndef _SSD1322_SPI_GRAPHICS_H_
 #define _SSD1322_SPI_GRAPHICS_H_
 
+#include <algorithm>
 #include <utility>
 
 #include "Ssd1322Spi.h"
 #include "GraphicsApi.h"
+#include "PackedRow.h"
+#include "RowHashShadow.h"
 
 /**
  * SSD1322 over SPI using a framebuffer to expose a high level graphics API.
  *
- * TODO: don't make it a fixed 256*64 width
+ * templated on panel size and the display RAM column address (in 4-pixel units) of its leftmost column,
+ * and on whether row hashes for setRowHashing are kept (4 bytes per row)
  */
-class Ssd1322SpiGraphics: public Ssd1322Spi, public PixelGraphics {
+template <uint16_t width = 256, uint8_t height = 64, uint8_t colOffs = 0x1c, bool hashRows = false>
+class Ssd1322SpiGraphics: public Ssd1322Spi, public PixelGraphics, public ChunkedUpdate {
 public:
-  Ssd1322SpiGraphics(SPI& spi, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset) :
-    Ssd1322Spi(spi, cs, dc, reset) {
+  static_assert(width % 4 == 0 && width <= 256, "width must be a multiple of 4, up to 256");
+  static_assert(height <= kRamRows, "height must fit in display RAM");
+
+  Ssd1322SpiGraphics(DisplayBus& bus, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset) :
+    Ssd1322Spi(bus, cs, dc, reset) {
+  }
+
+  void init() {  // wrapper around Ssd1322Spi::init that passes through template args
+    Ssd1322Spi::init(height, colOffs);
+  }
+
+  void startInit() {  // non-blocking init, completed through poll()
+    Ssd1322Spi::startInit(height, colOffs);
   }
 
   void update() {
-    beginWrite(0, 255, 0, 63);
-    dc_ = 1;
-    for (size_t i=0; i<sizeof(framebuffer_); i++) {
-      spi_.write(framebuffer_[i]);
+    if (hardwareScroll_) {
+      // runs of framebuffer rows are contiguous in display RAM except where the ring wraps
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        while (rowStart <= rowEnd) {
+          uint16_t runEnd = rowStart;
+          while (runEnd < rowEnd && ramRow(runEnd + 1) == ramRow(runEnd) + 1) {
+            runEnd++;
+          }
+          writeRows(rowStart, runEnd, ramRow(rowStart));
+          rowStart = runEnd + 1;
+        }
+      });
+      setStartLine(startLine_);
+    } else if (pageFlip_) {
+      uint8_t backPage = (frontPage_ == 0) ? 1 : 0;
+      updatePage(backPage);
+      showPage(backPage);
+    } else if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        writeRows(rowStart, rowEnd, rowStart);
+      });
+    } else {
+      writeRows(0, height - 1, 0);
     }
-    endWrite();
+  }
+
+  // Chunked updates send runs of rows, changed rows only with row hashing enabled.
+  // In hardware scroll and page flip modes the whole update is sent as one chunk.
+  void beginUpdate() {
+    if (hardwareScroll_ || pageFlip_) {
+      return;
+    } else if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        pendingRows_.add(rowStart, rowEnd);
+      });
+    } else {
+      pendingRows_.addAll();
+    }
+  }
+
+  bool updateChunk(size_t maxBytes) {
+    if (hardwareScroll_ || pageFlip_) {
+      pendingRows_.clear();
+      update();
+      return true;
+    }
+    uint16_t rowStart, rowEnd;
+    if (pendingRows_.takeRun(std::max<size_t>(1, maxBytes / kStride), rowStart, rowEnd)) {
+      writeRows(rowStart, rowEnd, rowStart);
+    }
+    return pendingRows_.empty();
+  }
+
+  // When enabled, update() only sends rows drawn to since the last update, as consecutive-row windowed
+  // writes. With hashRows, rows drawn to but hashing the same as last sent are skipped too, costing a
+  // hash of each row drawn to per update.
+  void setRowHashing(bool enable) {
+    rowHashing_ = enable;
+    rowHashes_.invalidate();
+  }
+
+  /**
+   * Hardware scroll mode, where the framebuffer is a ring of rows mapped onto the kRamRows-row display RAM
+   * and hardwareScroll() only moves the display start line. update() then sends only rows that were
+   * drawn to or exposed by scrolling, regardless of setRowHashing.
+   * streamImage is not supported in this mode.
+   */
+  void setHardwareScroll(bool enable) {
+    assert(!pageFlip_);
+    if (hardwareScroll_ && !enable) {  // rotate the ring back so the top row is first
+      std::rotate(framebuffer_, framebuffer_ + topRow_ * kStride, framebuffer_ + sizeof(framebuffer_));
+    }
+    hardwareScroll_ = enable;
+    topRow_ = 0;
+    startLine_ = 0;
+    rowHashes_.invalidate();
+    setStartLine(0);
+  }
+
+  // Scrolls the display contents up by lines (down if negative), filling exposed rows with fillContrast.
+  // In hardware scroll mode this costs a memset per exposed row, otherwise it falls back to scrollRect.
+  void hardwareScroll(int16_t lines, uint8_t fillContrast = 0) {
+    if (!hardwareScroll_) {
+      scrollRect(0, 0, width, height, 0, -lines, fillContrast);
+      return;
+    }
+    lines = std::max<int16_t>(-height, std::min<int16_t>(height, lines));
+    topRow_ = (topRow_ + height + lines) % height;
+    startLine_ = (startLine_ + kRamRows + lines) % kRamRows;
+
+    uint16_t exposedStart = lines > 0 ? height - lines : 0;  // in logical rows
+    uint16_t exposedEnd = lines > 0 ? height : -lines;
+    for (uint16_t y=exposedStart; y<exposedEnd; y++) {
+      uint16_t rowIndex = fbRow(y);
+      memset(framebuffer_ + rowIndex * kStride, Gray4Format::fromContrast(fillContrast) * 0x11, kStride);
+      rowHashes_.forget(rowIndex);  // now maps to a different display RAM row
+    }
+  }
+
+  /**
+   * Page flip mode, where the display RAM holds kPages full frames and update() writes the framebuffer
+   * to the off-screen page then shows it with a single start line command, so frames never tear.
+   * Row hashing does not apply in this mode, and streamImage is not supported.
+   */
+  void setPageFlip(bool enable) {
+    assert(!hardwareScroll_);
+    pageFlip_ = enable;
+    rowHashes_.invalidate();
+    showPage(0);
+  }
+
+  static const uint8_t kPages = kRamRows / height;
+
+  // Writes the framebuffer to a page of display RAM without showing it, so pre-rendered screens
+  // can be kept resident in the controller and switched to with showPage.
+  void updatePage(uint8_t page) {
+    assert(page < kPages);
+    writeRows(0, height - 1, page * height);
+  }
+
+  // Shows a page of display RAM, a single command
+  void showPage(uint8_t page) {
+    assert(page < kPages);
+    frontPage_ = page;
+    setStartLine(page * height);
   }
 
   uint16_t getWidth() {
-    return 256;
+    return width;
   }
   uint16_t getHeight() {
-    return 64;
+    return height;
   }
 
   void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) {
+    if (x >= width || y >= height) {
+      return;
+    }
+
     bool writeMsNibble = (x % 2) == 0;
-    contrast = contrast >> 4;
-    framebuffer_[(y*128)+(x/2)] &= writeMsNibble ? 0x0f : 0xf0;  // unset pixel
-    framebuffer_[(y*128)+(x/2)] |= contrast << (writeMsNibble ? 4 : 0);  // set pixel
+    contrast = dithers(contrast) ? OrderedDither::gray4(x, y, contrast) : Gray4Format::fromContrast(contrast);
+    uint16_t row = fbRow(y);
+    framebuffer_[(row*kStride)+(x/2)] &= writeMsNibble ? 0x0f : 0xf0;  // unset pixel
+    framebuffer_[(row*kStride)+(x/2)] |= contrast << (writeMsNibble ? 4 : 0);  // set pixel
+    rowHashes_.touch(row);
+  }
+
+  // Fills a row span a byte of two pixels at a time, or a byte pair when dithered
+  void drawHSpan(uint16_t x, uint16_t y, uint16_t w, uint8_t contrast) {
+    uint16_t rowIndex = fbRow(y);
+    uint8_t* row = framebuffer_ + rowIndex * kStride;
+    if (dithers(contrast)) {
+      uint8_t even, odd;
+      OrderedDither::gray4Pattern(y, contrast, even, odd);
+      PackedRow::fillBits(row, x * 4, w * 4, even, odd);
+    } else {
+      PackedRow::fillBits(row, x * 4, w * 4, Gray4Format::fromContrast(contrast) * 0x11);
+    }
+    rowHashes_.touch(rowIndex);
+  }
+
+  // Draws a 1bpp glyph row 4 pixels at a time, each source nibble expanded to a mask of 4 framebuffer nibbles
+  void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawGlyphRowPixels(x, y, glyph, w, contrast);
+      return;
+    }
+    static const uint16_t kNibbleExpand[16] = {
+      0x0000, 0x000f, 0x00f0, 0x00ff, 0x0f00, 0x0f0f, 0x0ff0, 0x0fff,
+      0xf000, 0xf00f, 0xf0f0, 0xf0ff, 0xff00, 0xff0f, 0xfff0, 0xffff,
+    };
+    uint8_t fill = Gray4Format::fromContrast(contrast) * 0x11;
+    uint16_t rowIndex = fbRow(y);
+    uint8_t* row = framebuffer_ + rowIndex * kStride;
+    for (uint8_t col=0; col<w; col+=4) {
+      uint8_t bits = (glyph[col / 8] >> ((col % 8) ? 0 : 4)) & 0x0f;
+      if (w - col < 4) {
+        bits &= (0xf0 >> (w - col)) & 0x0f;
+      }
+      if (bits == 0) {
+        continue;
+      }
+      uint16_t pos = x + col;
+      uint32_t mask = (uint32_t)kNibbleExpand[bits] << (8 - 4 * (pos % 2));  // over 3 framebuffer bytes
+      uint8_t* dst = row + pos / 2;
+      for (uint8_t i=0; i<3; i++) {
+        uint8_t byteMask = mask >> (16 - 8 * i);
+        if (byteMask) {
+          dst[i] = (dst[i] & ~byteMask) | (fill & byteMask);
+        }
+      }
+    }
+    rowHashes_.touch(rowIndex);
+  }
+
+  /**
+   * Draws text, blending fonts with gray rows (GrayFont) antialiased: each pixel is interpolated from
+   * what is already drawn towards the contrast by its coverage, so glyphs blend over any background,
+   * light or dark. Other fonts draw as PixelGraphics::text.
+   */
+  uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t contrast = 255) {
+    if (font.getGlyphLayout() != GraphicsFont::kGrayRows) {
+      return PixelGraphics::text(x, y, string, font, contrast);
+    }
+    return textGray(x, y, string, font, Gray4Format::fromContrast(contrast));
+  }
+  uint16_t text(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, Color color) {
+    if (font.getGlyphLayout() != GraphicsFont::kGrayRows) {
+      return PixelGraphics::text(x, y, string, font, color);
+    }
+    return textGray(x, y, string, font, Gray4Format::fromColor(color));
+  }
+
+  // Copies rows directly for 4bpp gray bitmaps at even x without transparency,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::GRAY_4BPP || bitmap.hasTransparency() || (x % 2) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    for (uint16_t row=0; row<h; row++) {
+      const uint8_t* src = bitmap.getRow(row);
+      uint16_t rowIndex = fbRow(y + row);
+      uint8_t* dst = framebuffer_ + rowIndex * kStride + x / 2;
+      memcpy(dst, src, w / 2);
+      if (w % 2 != 0) {  // odd width, copy the trailing MsNibble only
+        dst[w / 2] = (dst[w / 2] & 0x0f) | (src[w / 2] & 0xf0);
+      }
+      rowHashes_.touch(rowIndex);
+    }
+  }
+
+  // Decodes 4bpp gray images at even x directly into the framebuffer,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::GRAY_4BPP || (x % 2) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      uint16_t rowIndex = fbRow(y + row);
+      uint8_t* dst = framebuffer_ + rowIndex * kStride + x / 2;
+      decoder.read(dst, w / 2);
+      if (w % 2 != 0) {  // odd width, copy the trailing MsNibble only
+        dst[w / 2] = (dst[w / 2] & 0x0f) | (decoder.next() & 0xf0);
+      }
+      decoder.skip(bitmap.getStride() - (w + 1) / 2);
+      rowHashes_.touch(rowIndex);
+    }
+  }
+
+  // Copies rows as nibble streams, a memmove per row when srcX and dstX have the same parity
+  void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) {
+    if (!clipCopyRect(srcX, srcY, w, h, dstX, dstY)) {
+      return;
+    }
+    for (uint16_t i=0; i<h; i++) {
+      uint16_t row = (dstY > srcY) ? h - 1 - i : i;  // copy away from the overlap
+      uint16_t dstRow = fbRow(dstY + row);
+      PackedRow::copyBits(framebuffer_ + dstRow * kStride, dstX * 4,
+          framebuffer_ + fbRow(srcY + row) * kStride, srcX * 4, w * 4, kStride);
+      rowHashes_.touch(dstRow);
+    }
+  }
+
+  // Streams a 4bpp gray image straight to the display RAM at SPI rate, without going through
+  // (or modifying) the framebuffer. The next update() overwrites it.
+  // x and the image width must be divisible by 4, the image must fit on the display.
+  void streamImage(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    assert(!hardwareScroll_ && !pageFlip_);
+    assert(bitmap.getFormat() == Bitmap::GRAY_4BPP);
+    assert(x % 4 == 0 && bitmap.getWidth() % 4 == 0);
+    assert(x + bitmap.getWidth() <= width && y + bitmap.getHeight() <= height);
+
+    beginWrite(x, x + bitmap.getWidth() - 1, y, y + bitmap.getHeight() - 1);
+    PackBitsDecoder decoder(bitmap.getData());
+    decoder.stream(bus_, (size_t)bitmap.getStride() * bitmap.getHeight());  // rows are contiguous in the window
+    endWrite();
+    rowHashes_.invalidate();  // display RAM no longer matches the framebuffer
   }
 
 protected:
-  uint8_t framebuffer_[256*64/2];  // in display memory order, byte=(MsNibble=1, LsNibble=0), x (row), y (col)
+  static const uint16_t kStride = width / 2;  // bytes per framebuffer row
+
+  uint8_t getGrayLevels() {
+    return 16;
+  }
+
+  // Returns the framebuffer row holding a display row (less than height), which differ only in hardware
+  // scroll mode
+  uint16_t fbRow(uint16_t y) {
+    if (!hardwareScroll_) {
+      return y;
+    }
+    uint16_t row = y + topRow_;
+    return row >= height ? row - height : row;
+  }
+
+  // Returns the display RAM row a framebuffer row is sent to
+  uint8_t ramRow(uint16_t fbRow) {
+    return (startLine_ + (fbRow + height - topRow_) % height) % kRamRows;
+  }
+
+  // Draws text in a gray font, blending each glyph row into the framebuffer at a gray level
+  uint16_t textGray(uint16_t x, uint16_t y, const char* string, GraphicsFont& font, uint8_t level) {
+    uint16_t rows = y < height ? std::min<uint16_t>(font.getFontHeight(), height - y) : 0;
+    uint16_t origx = x;
+    while (*string != 0) {
+      const uint8_t* charData;
+      uint8_t charWidth;
+      font.nextGlyph(string, charData, charWidth);
+      if (charData == NULL) {
+        continue;
+      }
+      if (x >= width && charWidth > 0) {
+        return width - origx;
+      }
+      uint16_t cols = std::min<uint16_t>(charWidth, width - x);
+      for (uint16_t row=0; row<rows; row++) {
+        uint16_t rowIndex = fbRow(y + row);
+        blendRow(framebuffer_ + rowIndex * kStride, x, charData + row * GrayFont::getStride(charWidth), cols, level);
+        rowHashes_.touch(rowIndex);
+      }
+      if (cols < charWidth) {
+        return width - origx;
+      }
+      x += charWidth + 1;  // inter-character space
+    }
+    return x > origx ? x - origx - 1 : 0;  // don't count the trailing space
+  }
+
+  // Returns a gray level interpolated from background towards level by coverage out of 15
+  static uint8_t blend(uint8_t background, uint8_t level, uint8_t coverage) {
+    return (background * (15 - coverage) + level * coverage + 7) / 15;
+  }
+
+  // Blends cols pixels of 4bpp coverage into a framebuffer row from x, towards a gray level.
+  // Uncovered pixel pairs are skipped and fully covered ones set, a byte at a time when x is even.
+  static void blendRow(uint8_t* row, uint16_t x, const uint8_t* coverage, uint16_t cols, uint8_t level) {
+    uint16_t col = 0;
+    if (x % 2 == 0) {
+      uint8_t* dst = row + x / 2;
+      for (; col + 1 < cols; col += 2, dst++) {
+        uint8_t pair = coverage[col / 2];
+        if (pair == 0xff) {
+          *dst = level * 0x11;
+        } else if (pair != 0) {
+          *dst = (blend(*dst >> 4, level, pair >> 4) << 4) | blend(*dst & 0x0f, level, pair & 0x0f);
+        }
+      }
+    }
+    for (; col < cols; col++) {
+      uint8_t pixelCoverage = (col % 2 == 0) ? coverage[col / 2] >> 4 : coverage[col / 2] & 0x0f;
+      if (pixelCoverage == 0) {
+        continue;
+      }
+      uint8_t* dst = row + (x + col) / 2;
+      uint8_t shift = ((x + col) % 2 == 0) ? 4 : 0;
+      *dst = (*dst & ~(0x0f << shift)) | (blend((*dst >> shift) & 0x0f, level, pixelCoverage) << shift);
+    }
+  }
+
+  // Sends the framebuffer rows between rowStart and rowEnd, inclusive, to display RAM starting at ramRowStart
+  void writeRows(uint16_t rowStart, uint16_t rowEnd, uint8_t ramRowStart) {
+    beginWrite(0, width - 1, ramRowStart, ramRowStart + (rowEnd - rowStart));
+    bus_.data(framebuffer_ + rowStart * kStride, (rowEnd - rowStart + 1) * kStride);
+    endWrite();
+  }
+
+  uint8_t framebuffer_[width*height/2];  // in display memory order, byte=(MsNibble=1, LsNibble=0), x (row), y (col)
+
+  bool rowHashing_ = false;
+  RowHashShadow<height, hashRows> rowHashes_;
+  RowSet<height> pendingRows_;  // rows not yet sent of a chunked update
+
+  bool hardwareScroll_ = false;
+  uint8_t topRow_ = 0;  // framebuffer row shown at the top of the display
+  uint8_t startLine_ = 0;  // display RAM row shown at the top of the display
+
+  bool pageFlip_ = false;
+  uint8_t frontPage_ = 0;  // display RAM page currently shown
 };
 
 #endif
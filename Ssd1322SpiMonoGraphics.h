@@ -0,0 +1,219 @@
+#ifndef _SSD1322_SPI_MONO_GRAPHICS_H_
+#define _SSD1322_SPI_MONO_GRAPHICS_H_
+
+#include <algorithm>
+
+#include "Ssd1322Spi.h"
+#include "GraphicsApi.h"
+#include "PackedRow.h"
+#include "RowHashShadow.h"
+
+// Lookup table expanding a byte of 1bpp pixels into a mask of 8 4bpp pixels
+extern const uint32_t kSsd1322MonoExpand[256];
+
+/**
+ * SSD1322 over SPI using a 1bpp framebuffer, for monochrome content at an eighth of the memory of
+ * Ssd1322SpiGraphics (2 KB instead of 8 KB at 256*64).
+ * Set pixels are shown at the foreground gray level and cleared pixels at the background gray level,
+ * expanded to 4bpp through a lookup table as bytes are streamed to the display.
+ * hashRows keeps row hashes for setRowHashing, 4 bytes per row.
+ */
+template <uint16_t width = 256, uint8_t height = 64, uint8_t colOffs = 0x1c, bool hashRows = false>
+class Ssd1322SpiMonoGraphics: public Ssd1322Spi, public PixelGraphics {
+public:
+  static_assert(width % 8 == 0 && width <= 256, "width must be a multiple of 8, up to 256");
+  static_assert(height <= kRamRows, "height must fit in display RAM");
+
+  Ssd1322SpiMonoGraphics(DisplayBus& bus, DigitalOut& cs, DigitalOut &dc, DigitalOut& reset) :
+    Ssd1322Spi(bus, cs, dc, reset) {
+  }
+
+  void init() {  // wrapper around Ssd1322Spi::init that passes through template args
+    Ssd1322Spi::init(height, colOffs);
+  }
+
+  void startInit() {  // non-blocking init, completed through poll()
+    Ssd1322Spi::startInit(height, colOffs);
+  }
+
+  void update() {
+    if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        writeRows(rowStart, rowEnd);
+      });
+    } else {
+      writeRows(0, height - 1);
+    }
+  }
+
+  // When enabled, update() only sends rows drawn to since the last update, as consecutive-row windowed
+  // writes. With hashRows, rows drawn to but hashing the same as last sent are skipped too, costing a
+  // hash of each row drawn to per update.
+  void setRowHashing(bool enable) {
+    rowHashing_ = enable;
+    rowHashes_.invalidate();
+  }
+
+  // Sets the contrast shown for set and cleared pixels, quantized to 16 levels
+  void setGrayLevels(uint8_t foreground, uint8_t background = 0) {
+    foreground_ = (uint32_t)Gray4Format::fromContrast(foreground) * 0x11111111;
+    background_ = (uint32_t)Gray4Format::fromContrast(background) * 0x11111111;
+    rowHashes_.invalidate();
+  }
+
+  uint16_t getWidth() {
+    return width;
+  }
+  uint16_t getHeight() {
+    return height;
+  }
+
+  void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) {
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint8_t* bufferByte = framebuffer_ + (y * kStride + (x / 8));
+    uint8_t bufferBitMask = 1 << (7 - (x%8));
+    if (dithers(contrast) ? !OrderedDither::mono(x, y, contrast) : !Mono1Format::fromContrast(contrast)) {
+      *bufferByte = *bufferByte & ~bufferBitMask;
+    } else {
+      *bufferByte = *bufferByte | bufferBitMask;
+    }
+    rowHashes_.touch(y);
+  }
+
+  // Span kernels: whole bytes in a row, or a bit mask walking down the stride
+  void drawHSpan(uint16_t x, uint16_t y, uint16_t w, uint8_t contrast) {
+    uint8_t fill = dithers(contrast) ? OrderedDither::monoPattern(y, contrast) : (Mono1Format::fromContrast(contrast) ? 0xff : 0x00);
+    PackedRow::fillBits(framebuffer_ + y * kStride, x, w, fill);
+    rowHashes_.touch(y);
+  }
+
+  void drawVSpan(uint16_t x, uint16_t y, uint16_t h, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawVSpanPixels(x, y, h, contrast);
+      return;
+    }
+    PackedColumn::fill(framebuffer_ + y * kStride + x / 8, kStride, 0x80 >> (x % 8), h,
+        Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawGlyphColumnPixels(x, y, glyph, h, contrast);
+      return;
+    }
+    PackedColumn::drawGlyph(framebuffer_ + y * kStride + x / 8, kStride, 0x80 >> (x % 8), glyph, h,
+        Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, uint8_t contrast) {
+    if (dithers(contrast)) {
+      drawGlyphRowPixels(x, y, glyph, w, contrast);
+      return;
+    }
+    PackedRow::drawBits(framebuffer_ + y * kStride, x, glyph, w, Mono1Format::fromContrast(contrast));
+    rowHashes_.touch(y);
+  }
+
+  using PixelGraphics::clear;
+
+  void clear() {  // optimized clear that understands the framebuffer format
+    memset(framebuffer_, 0, sizeof(framebuffer_));
+    rowHashes_.touchAll();
+  }
+
+  // Copies rows directly for 1bpp bitmaps at byte-aligned x without transparency,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::MONO_1BPP || bitmap.hasTransparency() || (x % 8) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    for (uint16_t row=0; row<h; row++) {
+      PackedRow::copyBits(framebuffer_ + (y + row) * kStride, x, bitmap.getRow(row), 0, w, bitmap.getStride());
+    }
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  // Decodes 1bpp images at byte-aligned x directly into the framebuffer,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    if (bitmap.getFormat() != Bitmap::MONO_1BPP || (x % 8) != 0) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      uint8_t* dst = framebuffer_ + (y + row) * kStride + x / 8;
+      decoder.read(dst, w / 8);
+      if (w % 8 != 0) {  // partial trailing byte
+        uint8_t mask = 0xff << (8 - (w % 8));
+        dst[w / 8] = (dst[w / 8] & ~mask) | (decoder.next() & mask);
+      }
+      decoder.skip(bitmap.getStride() - (w + 7) / 8);
+    }
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  // Copies rows as bit streams, a memmove per row when srcX and dstX have the same alignment in a byte
+  void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) {
+    if (!clipCopyRect(srcX, srcY, w, h, dstX, dstY)) {
+      return;
+    }
+    for (uint16_t i=0; i<h; i++) {
+      uint16_t row = (dstY > srcY) ? h - 1 - i : i;  // copy away from the overlap
+      PackedRow::copyBits(framebuffer_ + (dstY + row) * kStride, dstX,
+          framebuffer_ + (srcY + row) * kStride, srcX, w, kStride);
+    }
+    rowHashes_.touch(dstY, dstY + h - 1);
+  }
+
+protected:
+  static const uint16_t kStride = width / 8;  // bytes per framebuffer row
+
+  uint8_t getGrayLevels() {
+    return 2;
+  }
+
+  // Sends the framebuffer rows between rowStart and rowEnd, inclusive, expanding each byte to 8 gray pixels
+  // a row at a time
+  void writeRows(uint16_t rowStart, uint16_t rowEnd) {
+    beginWrite(0, width - 1, rowStart, rowEnd);
+    uint8_t rowData[width / 2];
+    for (uint16_t row=rowStart; row<=rowEnd; row++) {
+      for (uint16_t i=0; i<kStride; i++) {
+        uint32_t mask = kSsd1322MonoExpand[framebuffer_[row * kStride + i]];
+        uint32_t pixels = (foreground_ & mask) | (background_ & ~mask);
+        rowData[i*4] = pixels >> 24;
+        rowData[i*4 + 1] = (pixels >> 16) & 0xff;
+        rowData[i*4 + 2] = (pixels >> 8) & 0xff;
+        rowData[i*4 + 3] = pixels & 0xff;
+      }
+      bus_.data(rowData, sizeof(rowData));
+    }
+    endWrite();
+  }
+
+  uint8_t framebuffer_[width*height/8] = {0};  // in display memory order, MSB leftmost, x (row), y (col)
+
+  uint32_t foreground_ = 0xffffffff;  // gray level of set pixels, replicated to each of 8 nibbles
+  uint32_t background_ = 0;
+
+  bool rowHashing_ = false;
+  RowHashShadow<height, hashRows> rowHashes_;
+};
+
+#endif
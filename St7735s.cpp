@@ -1,29 +1,89 @@
 #include "St7735s.h"
 
-St7735s::St7735s(SPI& spi, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset) :
-  spi_(spi), cs_(cs), rs_(rs), reset_(reset) {
+St7735s::St7735s(DisplayBus& bus, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset) :
+  bus_(bus, cs, rs, 15 * 1000 * 1000), reset_(reset) {  // write up to 15 MHz (66ns cycle)
   reset_ = 0;
-  cs_ = 1;
 }
 
-void St7735s::init(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y) {
-  spi_.frequency(15 * 1000 * 1000);  // write up to 15 MHz (66ns cycle)
-  reset_ = 0;
-  wait_us(10);  // reset pulse
-  reset_ = 1;
-  wait_us(120*1000);  // wait for LCD to reset
-
-  cmd(Cmd::SLPOUT, 0, {});
+void St7735s::init(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y, uint8_t pixel_format) {
+  startInit(width, height, start_x, start_y, pixel_format);
+  runToCompletion();
+}
 
-  uint8_t colmod_data[] = {PixelFormat::IFPF_12B};
-  cmd(Cmd::COLMOD, 1, colmod_data);
-  uint8_t madctl_data[] = {MemoryAccess::MADCTL_MY | MemoryAccess::MADCTL_MV | MemoryAccess::MADCTL_BGR};
-  cmd(Cmd::MADCTL, 1, madctl_data);
-  set_window(width, height, start_x, start_y);
+void St7735s::startInit(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y, uint8_t pixel_format) {
+  initArgs_.width = width;
+  initArgs_.height = height;
+  initArgs_.start_x = start_x;
+  initArgs_.start_y = start_y;
+  initArgs_.pixel_format = pixel_format;
+  initStep_ = kInitReset;
+  cancelDelay();
+}
 
-  cmd(Cmd::DISPON, 0, {});
+bool St7735s::poll(uint32_t nowUs) {
+  // power-on sequence for each interface pixel format, differing only in the COLMOD data. The window depends
+  // on the panel, so is set after the table, in the same transaction and still after MADCTL.
+  static constexpr uint8_t kMadctl = MemoryAccess::MADCTL_MY | MemoryAccess::MADCTL_MV | MemoryAccess::MADCTL_BGR;
+  static constexpr uint8_t kInitSequence12b[] = {
+    Cmd::SLPOUT, DisplayBusDevice::kSequenceDelay, 120,  // wait to leave sleep
+    Cmd::COLMOD, 1, PixelFormat::IFPF_12B,
+    Cmd::MADCTL, 1, kMadctl,
+    Cmd::DISPON, 0,
+    Cmd::INVON, 0,
+  };
+  static constexpr uint8_t kInitSequence16b[] = {
+    Cmd::SLPOUT, DisplayBusDevice::kSequenceDelay, 120,
+    Cmd::COLMOD, 1, PixelFormat::IFPF_16B,
+    Cmd::MADCTL, 1, kMadctl,
+    Cmd::DISPON, 0,
+    Cmd::INVON, 0,
+  };
+  static constexpr uint8_t kInitSequence18b[] = {
+    Cmd::SLPOUT, DisplayBusDevice::kSequenceDelay, 120,
+    Cmd::COLMOD, 1, PixelFormat::IFPF_18B,
+    Cmd::MADCTL, 1, kMadctl,
+    Cmd::DISPON, 0,
+    Cmd::INVON, 0,
+  };
+  static_assert(sizeof(kInitSequence12b) == sizeof(kInitSequence16b)
+      && sizeof(kInitSequence12b) == sizeof(kInitSequence18b), "init sequences differ only in COLMOD data");
 
-  cmd(Cmd::INVON, 0, {});
+  if (delaying(nowUs)) {
+    return false;
+  }
+  switch (initStep_) {
+    case kInitReset:
+      reset_ = 0;
+      delay(nowUs, 10);  // reset pulse
+      initStep_ = kInitResetRelease;
+      return false;
+    case kInitResetRelease:
+      reset_ = 1;
+      delay(nowUs, 120*1000);  // wait for LCD to reset
+      initOffset_ = 0;
+      initStep_ = kInitConfigure;
+      return false;
+    case kInitConfigure: {
+      const uint8_t* sequence = kInitSequence12b;
+      if (initArgs_.pixel_format == PixelFormat::IFPF_16B) {
+        sequence = kInitSequence16b;
+      } else if (initArgs_.pixel_format == PixelFormat::IFPF_18B) {
+        sequence = kInitSequence18b;
+      }
+      uint8_t delayMs;
+      initOffset_ = bus_.runSequence(sequence, sizeof(kInitSequence12b), initOffset_, delayMs);
+      if (delayMs != 0) {
+        delay(nowUs, delayMs * 1000);
+        return false;
+      }
+      set_window(initArgs_.width, initArgs_.height, initArgs_.start_x, initArgs_.start_y);
+      bus_.release();
+      initStep_ = kInitIdle;
+      return true;
+    }
+    default:
+      return true;
+  }
 }
 
 void St7735s::set_window(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y) {
@@ -33,3 +93,14 @@ void St7735s::set_window(uint8_t width, uint8_t height, uint8_t start_x, uint8_t
   uint8_t raset_data[] = {0, start_y, 0, (uint8_t)(start_y + height - 1)};
   cmd(Cmd::RASET, 4, raset_data);
 }
+
+void St7735s::set_scroll_area(uint8_t top, uint8_t height) {
+  uint8_t bottom = kScanLines - top - height;
+  uint8_t vscrdef_data[] = {0, top, 0, height, 0, bottom};
+  cmd(Cmd::VSCRDEF, 6, vscrdef_data);
+}
+
+void St7735s::set_scroll_start(uint8_t line) {
+  uint8_t vscrsadd_data[] = {0, line};
+  cmd(Cmd::VSCRSADD, 2, vscrsadd_data);
+}
@@ -3,32 +3,70 @@
 
 #include <cstdint>
 #include <mbed.h>
+#include "DisplayBus.h"
+#include "DisplayTask.h"
 
 /**
  * ST7735S LCD controller driver module
  */
 
-class St7735s {
+class St7735s : public DisplayTask {
 public:
-  St7735s(SPI& spi, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset);
-  void init(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y);
+  enum PixelFormat {  // interface pixel format, as COLMOD data
+    IFPF_12B = 3,
+    IFPF_16B = 5,
+    IFPF_18B = 6,
+    IFPF_UNUSED = 7,
+  };
 
-protected:
-  inline void cmd(uint8_t command, size_t data_len, uint8_t* data) {
-    cs_ = 0;
+  St7735s(DisplayBus& bus, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset);
+  void init(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y, uint8_t pixel_format = IFPF_12B);
 
-    rs_ = 0;  // 0 for command data, 1 for display data
-    spi_.write(command);
-    rs_ = 1;
-    spi_.write((char*)data, data_len, NULL, 0);
+  // Starts a non-blocking init, which completes through poll() after the 120ms reset and sleep-out waits
+  void startInit(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y, uint8_t pixel_format = IFPF_12B);
 
-    cs_ = 1;
+  bool poll(uint32_t nowUs);
+
+protected:
+  // Sends a command and its data, holding CS asserted (grouping following commands into the same
+  // transaction) until bus_.release()
+  inline void cmd(uint8_t command, size_t data_len, const uint8_t* data) {
+    bus_.command(command, data, data_len);
   }
 
   void set_window(uint8_t width, uint8_t height, uint8_t start_x, uint8_t start_y);
 
-  SPI &spi_;
-  DigitalOut &cs_, &rs_, &reset_;
+  // Starts a RAMWR, so pixel data can be streamed with bus_.data
+  inline void begin_ram_write() {
+    bus_.command(Cmd::RAMWR);
+  }
+
+  // Ends the transaction started by the first command since the last end_ram_write, releasing CS
+  inline void end_ram_write() {
+    bus_.release();
+  }
+
+  // Defines the vertical scroll area as height lines starting at line top, the rest of the
+  // panel's lines are fixed. Scrolling is along the panel's scan direction.
+  void set_scroll_area(uint8_t top, uint8_t height);
+
+  // Sets the line shown at the start of the scroll area, enters vertical scroll mode
+  void set_scroll_start(uint8_t line);
+
+  DisplayBusDevice bus_;
+  DigitalOut &reset_;
+
+  enum InitStep {
+    kInitIdle,
+    kInitReset,
+    kInitResetRelease,
+    kInitConfigure,
+  };
+  InitStep initStep_ = kInitIdle;
+  size_t initOffset_ = 0;  // in the init sequence, to resume after its delays
+  struct {
+    uint8_t width, height, start_x, start_y, pixel_format;
+  } initArgs_;
 
   enum Cmd {
     SLPIN = 0x10,
@@ -45,17 +83,14 @@ protected:
     RAMWR = 0x2C,
     RGBSET = 0x2D,
     RAMRD = 0x2E,
+    VSCRDEF = 0x33,
+    VSCRSADD = 0x37,
 
     MADCTL = 0x36,
     COLMOD = 0x3A,  // pixel mode
   };
 
-  enum PixelFormat {
-    IFPF_12B = 3,
-    IFPF_16B = 5,
-    IFPF_18B = 6,
-    IFPF_UNUSED = 7,
-  };
+  static const uint8_t kScanLines = 162;  // lines of frame memory along the scan direction
 
   enum MemoryAccess {
     MADCTL_MX = 1 << 6,  // mirror X
@@ -1,27 +1,192 @@
-#ifndef _SSD1322_SPI_GRAPHICS_H_
-#define _SSD1322_SPI_GRAPHICS_H_
+#ifndef _ST7735S_GRAPHICS_H_
+#define _ST7735S_GRAPHICS_H_
+
+#include <algorithm>
 
 #include "St7735s.h"
 #include "GraphicsApi.h"
+#include "PackedRow.h"
+#include "RowHashShadow.h"
+
+/**
+ * Framebuffer layout of an ST7735S interface pixel format: the conversion to native pixel values,
+ * and the writer of a pixel into a framebuffer row stored in display transmit order.
+ */
+template <St7735s::PixelFormat format>
+struct St7735sFramebufferFormat;
+
+template <>
+struct St7735sFramebufferFormat<St7735s::IFPF_12B> : Rgb444Format {  // pixel pairs packed in 3 bytes
+  static const uint8_t kBitsPerPixel = 12;
+
+  static void writePixel(uint8_t* row, uint16_t x, Pixel rgb) {
+    uint8_t* pair = row + (x / 2 * 3);
+    if (x % 2 == 0) {
+      pair[0] = rgb >> 4;
+      pair[1] = (pair[1] & 0x0f) | ((rgb & 0x0f) << 4);
+    } else {
+      pair[1] = (pair[1] & 0xf0) | (rgb >> 8);
+      pair[2] = rgb & 0xff;
+    }
+  }
+};
+
+template <>
+struct St7735sFramebufferFormat<St7735s::IFPF_16B> : Rgb565Format {  // one big-endian halfword per pixel
+  static const uint8_t kBitsPerPixel = 16;
+
+  static void writePixel(uint8_t* row, uint16_t x, Pixel rgb) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    rgb = __builtin_bswap16(rgb);
+#endif
+    memcpy(row + x * 2, &rgb, 2);  // a single halfword store
+  }
+};
+
+template <>
+struct St7735sFramebufferFormat<St7735s::IFPF_18B> : Rgb666Format {  // one byte per component
+  static const uint8_t kBitsPerPixel = 24;
+
+  static void writePixel(uint8_t* row, uint16_t x, Pixel rgb) {
+    uint8_t* pixel = row + x * 3;
+    pixel[0] = rgb >> 16;
+    pixel[1] = rgb >> 8;
+    pixel[2] = rgb;
+  }
+};
 
 /**
  * ST7735S using a framebuffer to expose a high level graphics API.
  *
- * templated pixel format, currently RGB444 to save memory
+ * The framebuffer holds pixels in the interface pixel format they are transmitted in:
+ * IFPF_12B (RGB444) for RAM-constrained builds, or IFPF_16B (RGB565) where each pixel write is a single
+ * halfword store instead of the read-modify-write of a packed pair. IFPF_18B (RGB666) takes 3 bytes per pixel.
+ * Colors are drawn at the format's precision, contrasts as grays.
+ * hashRows keeps row hashes for setRowHashing, 4 bytes per row.
  */
-template <uint8_t width, uint8_t height, uint8_t xOffs, uint8_t yOffs>
-class St7735sGraphics: public St7735s, public PixelGraphics {
+template <uint8_t width, uint8_t height, uint8_t xOffs, uint8_t yOffs,
+    St7735s::PixelFormat format = St7735s::IFPF_12B, bool hashRows = false>
+class St7735sGraphics: public St7735s, public PixelGraphics, public ChunkedUpdate {
 public:
-  St7735sGraphics(SPI& spi, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset) :
-    St7735s(spi, cs, rs, reset) {
+  typedef St7735sFramebufferFormat<format> Format;
+
+  St7735sGraphics(DisplayBus& bus, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset) :
+    St7735s(bus, cs, rs, reset) {
   }
 
   void init() {  // wrapper around St7735s::init that passes through template args
-    St7735s::init(width, height, xOffs, yOffs);
+    St7735s::init(width, height, xOffs, yOffs, format);
+  }
+
+  void startInit() {  // non-blocking init, completed through poll()
+    St7735s::startInit(width, height, xOffs, yOffs, format);
   }
 
   void update() {
-    cmd(Cmd::RAMWR, width * height * 3 / 2, framebuffer_);
+    if (hardwareScroll_) {
+      updateColumns();
+    } else if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        set_window(width, rowEnd - rowStart + 1, xOffs, yOffs + rowStart);
+        cmd(Cmd::RAMWR, kStride * (rowEnd - rowStart + 1), framebuffer_ + rowStart * kStride);
+      });
+      set_window(width, height, xOffs, yOffs);
+    } else {
+      cmd(Cmd::RAMWR, sizeof(framebuffer_), framebuffer_);
+    }
+    end_ram_write();
+  }
+
+  // Chunked updates send windows of rows, changed rows only with row hashing enabled.
+  // In hardware scroll mode the whole update is sent as one chunk.
+  void beginUpdate() {
+    if (hardwareScroll_) {
+      return;
+    } else if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        pendingRows_.add(rowStart, rowEnd);
+      });
+    } else {
+      pendingRows_.addAll();
+    }
+  }
+
+  bool updateChunk(size_t maxBytes) {
+    if (hardwareScroll_) {
+      pendingRows_.clear();
+      update();
+      return true;
+    }
+    uint16_t rowStart, rowEnd;
+    if (pendingRows_.takeRun(std::max<size_t>(1, maxBytes / kStride), rowStart, rowEnd)) {
+      set_window(width, rowEnd - rowStart + 1, xOffs, yOffs + rowStart);
+      cmd(Cmd::RAMWR, kStride * (rowEnd - rowStart + 1), framebuffer_ + rowStart * kStride);
+    }
+    bool done = pendingRows_.empty();
+    if (done) {
+      set_window(width, height, xOffs, yOffs);
+    }
+    end_ram_write();
+    return done;
+  }
+
+  // When enabled, update() only sends rows drawn to since the last update, as consecutive-row windowed
+  // writes. With hashRows, rows drawn to but hashing the same as last sent are skipped too, costing a
+  // hash of each row drawn to per update.
+  void setRowHashing(bool enable) {
+    rowHashing_ = enable;
+    rowHashes_.invalidate();
+  }
+
+  /**
+   * Hardware scroll mode, where the framebuffer is a ring of columns matching the controller's
+   * vertical scroll area and hardwareScroll() only moves the scroll start address.
+   * update() then sends only columns that were drawn to or exposed by scrolling.
+   * In the transposed (MADCTL_MV) orientation set by init, the panel's scan direction is along x,
+   * so this scrolls horizontally, as for strip charts.
+   * Bitmap blits take the converting path in this mode.
+   */
+  void setHardwareScroll(bool enable) {
+    if (hardwareScroll_ && !enable) {  // rotate the ring back so the leftmost column is first
+      uint8_t rowCopy[kStride];
+      for (uint16_t y=0; y<height; y++) {
+        uint8_t* row = framebuffer_ + (y * kStride);
+        memcpy(rowCopy, row, sizeof(rowCopy));
+        PackedRow::copyBits(row, 0, rowCopy, leftCol_ * kBits, (width - leftCol_) * kBits, sizeof(rowCopy));
+        PackedRow::copyBits(row, (width - leftCol_) * kBits, rowCopy, 0, leftCol_ * kBits, sizeof(rowCopy));
+      }
+      cmd(Cmd::NORON, 0, {});  // leaves scroll mode
+    }
+    hardwareScroll_ = enable;
+    leftCol_ = 0;
+    rowHashes_.invalidate();
+    touchAllColumns();
+    if (enable) {
+      set_scroll_area(xOffs, width);
+      set_scroll_start(xOffs);
+    }
+    bus_.release();
+  }
+
+  // Scrolls the display contents left by columns (right if negative), filling exposed columns with fillContrast.
+  // In hardware scroll mode this only redraws the exposed columns, otherwise it falls back to scrollRect.
+  void hardwareScroll(int16_t columns, uint8_t fillContrast = 0) {
+    if (!hardwareScroll_) {
+      scrollRect(0, 0, width, height, -columns, 0, fillContrast);
+      return;
+    }
+    columns = std::max<int16_t>(-width, std::min<int16_t>(width, columns));
+    leftCol_ = (leftCol_ + width + columns) % width;
+    uint16_t exposedStart = columns > 0 ? width - columns : 0;  // in logical columns
+    uint16_t exposedEnd = columns > 0 ? width : -columns;
+    typename Format::Pixel fill = Format::fromContrast(fillContrast);
+    for (uint16_t x=exposedStart; x<exposedEnd; x++) {
+      uint16_t col = fbCol(x);
+      for (uint16_t y=0; y<height; y++) {
+        Format::writePixel(framebuffer_ + y * kStride, col, fill);
+      }
+      touchColumn(col);
+    }
   }
 
   uint16_t getWidth() {
@@ -32,29 +197,179 @@ public:
   }
 
   void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) {
-    uint8_t contrast4 = contrast >> 4;
+    drawNativePixel(x, y, Format::fromContrast(contrast));
+  }
 
+  void drawPixel(uint16_t x, uint16_t y, Color color) {
+    drawNativePixel(x, y, Format::fromColor(color));
+  }
+
+  // Copies rows directly for RGB444 bitmaps at even x without transparency into an RGB444 framebuffer,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const Bitmap& bitmap) {
+    if (format != IFPF_12B || bitmap.getFormat() != Bitmap::RGB_444 || bitmap.hasTransparency() || (x % 2) != 0
+        || hardwareScroll_) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
     if (x >= width || y >= height) {
       return;
     }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    for (uint16_t row=0; row<h; row++) {
+      memcpy(framebuffer_ + ((y + row) * kStride) + (x * 3 / 2), bitmap.getRow(row), w / 2 * 3);
+      if (w % 2 != 0) {  // odd width, trailing pixel is the first of a pair
+        Format::writePixel(framebuffer_ + (y + row) * kStride, x + w - 1, bitmap.getPixel(w - 1, row));
+      }
+    }
+    rowHashes_.touch(y, y + h - 1);
+  }
 
-    if (x % 2 == 0) {
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2)] = contrast4 | (contrast4 << 4);
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2) + 1] &= 0xf0;
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2) + 1] |= contrast4 << 4;
-    } else {
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2)] &= 0x0f;
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2)] |= contrast4;
-      framebuffer_[(y * width * 3 / 2)+(x * 3 / 2) + 1] = contrast4 | (contrast4 << 4);
+  // Decodes RGB444 images at even x directly into an RGB444 framebuffer,
+  // otherwise falls back to the converting blit
+  void blit(uint16_t x, uint16_t y, const CompressedBitmap& bitmap) {
+    if (format != IFPF_12B || bitmap.getFormat() != Bitmap::RGB_444 || (x % 2) != 0 || hardwareScroll_) {
+      PixelGraphics::blit(x, y, bitmap);
+      return;
+    }
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint16_t w = std::min<uint16_t>(bitmap.getWidth(), width - x);
+    uint16_t h = std::min<uint16_t>(bitmap.getHeight(), height - y);
+    PackBitsDecoder decoder(bitmap.getData());
+    for (uint16_t row=0; row<h; row++) {
+      decoder.read(framebuffer_ + ((y + row) * kStride) + (x * 3 / 2), w / 2 * 3);
+      if (w % 2 != 0) {  // odd width, trailing pixel is the first of a pair
+        uint8_t pair[3];
+        decoder.read(pair, 3);
+        Format::writePixel(framebuffer_ + (y + row) * kStride, x + w - 1,
+            Bitmap(Bitmap::RGB_444, 2, 1, pair).getPixel(0, 0));
+      }
+      decoder.skip(bitmap.getStride() - (w + 1) / 2 * 3);
+    }
+    rowHashes_.touch(y, y + h - 1);
+  }
+
+  // Copies rows as pixel bit streams, a memmove per row when srcX and dstX start on the same bit in a byte
+  void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) {
+    if (!clipCopyRect(srcX, srcY, w, h, dstX, dstY)) {
+      return;
+    }
+    for (uint16_t i=0; i<h; i++) {
+      uint16_t row = (dstY > srcY) ? h - 1 - i : i;  // copy away from the overlap
+      copyColumns(framebuffer_ + (dstY + row) * kStride, dstX,
+          framebuffer_ + (srcY + row) * kStride, srcX, w);
+    }
+    rowHashes_.touch(dstY, dstY + h - 1);
+    if (hardwareScroll_) {
+      for (uint16_t x=dstX; x<dstX+w; x++) {
+        touchColumn(fbCol(x));
+      }
     }
   }
 
+  using PixelGraphics::clear;
+
   void clear() {  // optimized clear that understands the framebuffer format
     memset(framebuffer_, 0, sizeof(framebuffer_));
+    rowHashes_.touchAll();
+    touchAllColumns();
   }
 
 protected:
-    uint8_t framebuffer_[width * height * 3 / 2];  // in display memory order, word=(RGB 444), x (row), y (col)
+  static const uint8_t kBits = Format::kBitsPerPixel;
+  static const uint16_t kStride = (uint16_t)width * kBits / 8;  // bytes per framebuffer row
+  static_assert(width % 2 == 0, "width must be whole pixel pairs");
+
+  void drawNativePixel(uint16_t x, uint16_t y, typename Format::Pixel pixel) {
+    if (x >= width || y >= height) {
+      return;
+    }
+
+    if (hardwareScroll_) {
+      uint16_t col = fbCol(x);
+      Format::writePixel(framebuffer_ + y * kStride, col, pixel);
+      touchColumn(col);
+    } else {
+      Format::writePixel(framebuffer_ + y * kStride, x, pixel);
+    }
+    rowHashes_.touch(y);
+  }
+
+  // Returns the framebuffer column holding a display column (less than width), which differ only in
+  // hardware scroll mode
+  uint16_t fbCol(uint16_t x) {
+    uint16_t col = x + leftCol_;
+    return col >= width ? col - width : col;
+  }
+
+  void touchColumn(uint16_t col) {
+    dirtyCols_[col / 32] |= (uint32_t)1 << (col % 32);
+  }
+
+  void touchAllColumns() {
+    memset(dirtyCols_, 0xff, sizeof(dirtyCols_));
+  }
+
+  bool columnTouched(uint16_t col) {
+    return dirtyCols_[col / 32] & ((uint32_t)1 << (col % 32));
+  }
+
+  // Copies w display columns between rows, splitting where the column ring wraps
+  void copyColumns(uint8_t* dstRow, uint16_t dstX, const uint8_t* srcRow, uint16_t srcX, uint16_t w) {
+    uint16_t pieceOffset[3], pieceLength[3];  // pieces that wrap in neither source nor destination
+    uint8_t pieces = 0;
+    for (uint16_t offset=0; offset<w; pieces++) {
+      pieceOffset[pieces] = offset;
+      pieceLength[pieces] = std::min<uint16_t>(w - offset,
+          std::min<uint16_t>(width - fbCol(srcX + offset), width - fbCol(dstX + offset)));
+      offset += pieceLength[pieces];
+    }
+    for (uint8_t i=0; i<pieces; i++) {
+      uint8_t piece = (dstX > srcX) ? pieces - 1 - i : i;  // copy away from the overlap
+      PackedRow::copyBits(dstRow, fbCol(dstX + pieceOffset[piece]) * kBits,
+          srcRow, fbCol(srcX + pieceOffset[piece]) * kBits, pieceLength[piece] * kBits, kStride);
+    }
+  }
+
+  // Sends runs of touched columns, rounded out to whole pixel pairs for RGB444, then moves the scroll start,
+  // all in one transaction (each window command ends the previous RAMWR)
+  void updateColumns() {
+    for (uint16_t col=0; col<width; col++) {
+      if (!columnTouched(col)) {
+        continue;
+      }
+      uint16_t colStart = (kBits % 8 != 0) ? col & ~1 : col;
+      while (col + 1 < width && columnTouched(col + 1)) {
+        col++;
+      }
+      if (kBits % 8 != 0) {
+        col = std::min<uint16_t>(col | 1, width - 1);
+      }
+
+      set_window(col - colStart + 1, height, xOffs + colStart, yOffs);
+      begin_ram_write();
+      for (uint16_t y=0; y<height; y++) {
+        bus_.data(framebuffer_ + (y * kStride) + (colStart * kBits / 8), (col - colStart + 1) * kBits / 8);
+      }
+    }
+    memset(dirtyCols_, 0, sizeof(dirtyCols_));
+    set_window(width, height, xOffs, yOffs);
+    set_scroll_start(xOffs + leftCol_);
+  }
+
+  // in display memory order, x (row), y (col); aligned for the halfword stores of RGB565
+  alignas(4) uint8_t framebuffer_[kStride * height];
+
+  bool rowHashing_ = false;
+  RowHashShadow<height, hashRows> rowHashes_;
+  RowSet<height> pendingRows_;  // rows not yet sent of a chunked update
+
+  bool hardwareScroll_ = false;
+  uint8_t leftCol_ = 0;  // framebuffer column shown at the left of the display
+  uint32_t dirtyCols_[(width + 31) / 32] = {0};  // bitmap of framebuffer columns drawn to, in hardware scroll mode
 };
 
 #endif
@@ -0,0 +1,205 @@
+#ifndef _ST7735S_INDEXED_GRAPHICS_H_
+#define _ST7735S_INDEXED_GRAPHICS_H_
+
+#include <algorithm>
+
+#include "St7735s.h"
+#include "GraphicsApi.h"
+#include "PackedRow.h"
+#include "RowHashShadow.h"
+
+/**
+ * ST7735S using a palette-indexed framebuffer (2 or 4 bits per pixel) to expose a high level graphics API,
+ * at 1/6 or 1/3 the memory of the RGB444 St7735sGraphics.
+ * Indices are converted to RGB565 through the palette as pixels are streamed to the display.
+ *
+ * Drawing with a contrast selects palette entry (contrast >> (8 - bpp)), which defaults to a gray ramp.
+ * Other colors are available by changing palette entries with setPaletteColor, and drawing with a Color
+ * selects the nearest palette entry, found once per span or glyph and cached for repeated colors.
+ * hashRows keeps row hashes for setRowHashing, 4 bytes per row.
+ */
+template <uint8_t width, uint8_t height, uint8_t xOffs, uint8_t yOffs, uint8_t bpp = 4, bool hashRows = false>
+class St7735sIndexedGraphics: public St7735s, public PixelGraphics {
+public:
+  static_assert(bpp == 2 || bpp == 4, "bpp must be 2 or 4");
+
+  St7735sIndexedGraphics(DisplayBus& bus, DigitalOut& cs, DigitalOut& rs, DigitalOut& reset) :
+    St7735s(bus, cs, rs, reset) {
+    for (uint8_t i=0; i<kColors; i++) {  // default gray ramp
+      uint8_t level = i * 255 / (kColors - 1);
+      setPaletteColor(i, level, level, level);
+    }
+  }
+
+  void init() {  // wrapper around St7735s::init that passes through template args
+    St7735s::init(width, height, xOffs, yOffs, PixelFormat::IFPF_16B);
+  }
+
+  void startInit() {  // non-blocking init, completed through poll()
+    St7735s::startInit(width, height, xOffs, yOffs, PixelFormat::IFPF_16B);
+  }
+
+  void update() {
+    if (rowHashing_) {
+      rowHashes_.forEachChangedRun(framebuffer_, kStride, [this](uint16_t rowStart, uint16_t rowEnd) {
+        set_window(width, rowEnd - rowStart + 1, xOffs, yOffs + rowStart);
+        writeRows(rowStart, rowEnd);
+      });
+      set_window(width, height, xOffs, yOffs);
+    } else {
+      writeRows(0, height - 1);
+    }
+    end_ram_write();
+  }
+
+  // When enabled, update() only sends rows drawn to since the last update, as consecutive-row windowed
+  // writes. With hashRows, rows drawn to but hashing the same as last sent are skipped too, costing a
+  // hash of each row drawn to per update.
+  void setRowHashing(bool enable) {
+    rowHashing_ = enable;
+    rowHashes_.invalidate();
+  }
+
+  static const uint8_t kColors = 1 << bpp;
+
+  // Sets a palette entry from 8-bit color components, the display is updated on the next update()
+  void setPaletteColor(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+    palette_[index] = Rgb565Format::fromColor(Color(r, g, b));
+    nearestValid_ = false;
+    rowHashes_.invalidate();
+  }
+
+  // Returns the contrast that draws with a palette entry
+  static uint8_t paletteContrast(uint8_t index) {
+    return index << (8 - bpp);
+  }
+
+  uint16_t getWidth() {
+    return width;
+  }
+  uint16_t getHeight() {
+    return height;
+  }
+
+  void drawPixel(uint16_t x, uint16_t y, uint8_t contrast) {
+    if (x >= width || y >= height) {
+      return;
+    }
+    uint8_t* bufferByte = framebuffer_ + (y * kStride + (x / kPixelsPerByte));
+    uint8_t shift = (kPixelsPerByte - 1 - (x % kPixelsPerByte)) * bpp;
+    *bufferByte = (*bufferByte & ~(kPixelMask << shift)) | ((contrast >> (8 - bpp)) << shift);
+    rowHashes_.touch(y);
+  }
+
+  // Draws with the palette entry nearest the color
+  void drawPixel(uint16_t x, uint16_t y, Color color) {
+    drawPixel(x, y, toContrast(color));
+  }
+
+  using PixelGraphics::clear;
+
+  void clear() {  // optimized clear that understands the framebuffer format
+    memset(framebuffer_, 0, sizeof(framebuffer_));
+    rowHashes_.touchAll();
+  }
+
+  // Copies rows as bit streams, a memmove per row when srcX and dstX have the same alignment in a byte
+  void copyRect(uint16_t srcX, uint16_t srcY, uint16_t w, uint16_t h, uint16_t dstX, uint16_t dstY) {
+    if (!clipCopyRect(srcX, srcY, w, h, dstX, dstY)) {
+      return;
+    }
+    for (uint16_t i=0; i<h; i++) {
+      uint16_t row = (dstY > srcY) ? h - 1 - i : i;  // copy away from the overlap
+      PackedRow::copyBits(framebuffer_ + (dstY + row) * kStride, dstX * bpp,
+          framebuffer_ + (srcY + row) * kStride, srcX * bpp, w * bpp, kStride);
+    }
+    rowHashes_.touch(dstY, dstY + h - 1);
+  }
+
+protected:
+  // Color kernels find the palette entry once, then draw as its contrast
+  using PixelGraphics::drawHSpan;
+  using PixelGraphics::drawVSpan;
+  using PixelGraphics::drawGlyphColumn;
+  using PixelGraphics::drawGlyphRow;
+
+  void drawHSpan(uint16_t x, uint16_t y, uint16_t w, Color color) {
+    drawHSpan(x, y, w, toContrast(color));
+  }
+  void drawVSpan(uint16_t x, uint16_t y, uint16_t h, Color color) {
+    drawVSpan(x, y, h, toContrast(color));
+  }
+  void drawGlyphColumn(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t h, Color color) {
+    drawGlyphColumn(x, y, glyph, h, toContrast(color));
+  }
+  void drawGlyphRow(uint16_t x, uint16_t y, const uint8_t* glyph, uint8_t w, Color color) {
+    drawGlyphRow(x, y, glyph, w, toContrast(color));
+  }
+
+  // Returns the contrast of the palette entry nearest a color, remembering the last color looked up
+  uint8_t toContrast(Color color) {
+    uint16_t rgb565 = Rgb565Format::fromColor(color);
+    if (!nearestValid_ || rgb565 != nearestRgb565_) {
+      nearestRgb565_ = rgb565;
+      nearestIndex_ = nearestPaletteIndex(rgb565);
+      nearestValid_ = true;
+    }
+    return paletteContrast(nearestIndex_);
+  }
+
+  static const uint8_t kPixelsPerByte = 8 / bpp;
+  static const uint8_t kPixelMask = (1 << bpp) - 1;
+  static const uint16_t kStride = width / kPixelsPerByte;  // bytes per framebuffer row
+  static const size_t kChunkBytes = 64;  // RGB565 bytes converted per SPI block write
+
+  // Returns the palette entry closest to an RGB565 color, by squared distance over the components
+  uint8_t nearestPaletteIndex(uint16_t rgb565) {
+    uint8_t nearest = 0;
+    uint32_t nearestDistance = UINT32_MAX;
+    for (uint8_t i=0; i<kColors; i++) {
+      int32_t dr = (int32_t)(palette_[i] >> 11) - (rgb565 >> 11);
+      int32_t dg = (int32_t)((palette_[i] >> 5) & 0x3f) - ((rgb565 >> 5) & 0x3f);
+      int32_t db = (int32_t)(palette_[i] & 0x1f) - (rgb565 & 0x1f);
+      uint32_t distance = 4*dr*dr + dg*dg + 4*db*db;  // 5-bit red and blue scaled to green's 6 bits
+      if (distance < nearestDistance) {
+        nearest = i;
+        nearestDistance = distance;
+      }
+    }
+    return nearest;
+  }
+
+  // Sends the framebuffer rows between rowStart and rowEnd, inclusive, into the current window,
+  // converting through the palette a chunk at a time
+  void writeRows(uint16_t rowStart, uint16_t rowEnd) {
+    uint8_t chunk[kChunkBytes];
+    size_t chunkLen = 0;
+    begin_ram_write();
+    for (size_t i=(size_t)rowStart*kStride; i<(size_t)(rowEnd+1)*kStride; i++) {
+      uint8_t pixels = framebuffer_[i];
+      for (uint8_t p=0; p<kPixelsPerByte; p++) {
+        uint16_t color = palette_[(pixels >> (8 - bpp)) & kPixelMask];
+        pixels <<= bpp;
+        chunk[chunkLen++] = color >> 8;
+        chunk[chunkLen++] = color & 0xff;
+      }
+      if (chunkLen == kChunkBytes) {
+        bus_.data(chunk, chunkLen);
+        chunkLen = 0;
+      }
+    }
+    bus_.data(chunk, chunkLen);
+  }
+
+  uint8_t framebuffer_[width * height / kPixelsPerByte];  // palette indices, MSB leftmost, x (row), y (col)
+  uint16_t palette_[kColors];  // RGB565
+
+  bool nearestValid_ = false;  // nearestIndex_ is the palette entry nearest nearestRgb565_
+  uint16_t nearestRgb565_;
+  uint8_t nearestIndex_;
+
+  bool rowHashing_ = false;
+  RowHashShadow<height, hashRows> rowHashes_;
+};
+
+#endif
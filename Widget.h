@@ -31,7 +31,7 @@ public:
 
 class TextWidget: public ValueContrastWidget<const char*> {
 public:
-  TextWidget(const char* value, uint8_t maxLength = 0, GeneratorFont& font = Font5x7, uint8_t contrast = 255) :
+  TextWidget(const char* value, uint8_t maxLength = 0, GraphicsFont& font = Font5x7, uint8_t contrast = 255) :
       value_(value), maxLength_(maxLength), font_(font), contrast_(contrast) {
   }
 
@@ -40,13 +40,7 @@ public:
     if (maxLengthWidth > 0) {  // remove trailing space
       maxLengthWidth -= 1;
     }
-    uint16_t realWidth = 0;
-    for (const char* valuePtr = value_; *valuePtr != 0; valuePtr++) {
-      realWidth += font_.getCharWidth(*valuePtr) + 1;
-    }
-    if (realWidth > 0) {  // remove trailing space
-      realWidth -= 1;
-    }
+    uint16_t realWidth = font_.measure(value_);
     size_ = Size(std::max(maxLengthWidth, realWidth), font_.getFontHeight());
     return size_;
   }
@@ -66,7 +60,7 @@ public:
 protected:
   const char* value_;
   uint8_t maxLength_;
-  GeneratorFont& font_;
+  GraphicsFont& font_;
   uint8_t contrast_;
 
   Size size_;
@@ -76,8 +70,8 @@ protected:
 class NumericTextWidget: public ValueContrastWidget<int32_t> {
 public:
   NumericTextWidget(int32_t value, uint8_t maxDigits = 0,
-      GeneratorFont& font = Font5x7, uint8_t contrast = 255,
-      GeneratorFont& fractionalFont = Font3x5, int32_t fractional = 1, uint8_t fractionalDigits = 0) :
+      GraphicsFont& font = Font5x7, uint8_t contrast = 255,
+      GraphicsFont& fractionalFont = Font3x5, int32_t fractional = 1, uint8_t fractionalDigits = 0) :
       maxDigits_(maxDigits), fractionalDigits_(fractionalDigits),
       fractional_(fractional), 
       contrast_(contrast),
@@ -199,7 +193,7 @@ protected:
 
 class LabelFrameWidget: public Widget {
 public:
-  LabelFrameWidget(Widget* contents, const char* title, GeneratorFont& font = Font3x5, uint8_t contrast = 255) :
+  LabelFrameWidget(Widget* contents, const char* title, GraphicsFont& font = Font3x5, uint8_t contrast = 255) :
   contents_(contents), title_(title), font_(font), contrast_(contrast) {
   }
 
@@ -214,8 +208,7 @@ public:
     gfx.line(x + 1,
         y + font_.getFontHeight() + 1 + innerSize_.height + 1,
         innerSize_.width + 2, 0, contrast_);
-    size_t titleLength = strlen(title_);
-    uint16_t topStart = x + 2 + titleLength * font_.getCharWidth('8') + (titleLength - 1) + 1;  // TODO don't assume 1 px space
+    uint16_t topStart = x + 2 + font_.measure(title_) + 1;
     uint16_t topEnd = x + 2 + innerSize_.width + 1;
     if (topEnd > topStart) {
       gfx.line(topStart,
@@ -240,7 +233,7 @@ public:
 protected:
   Widget* const contents_;
   const char* title_;
-  GeneratorFont& font_;
+  GraphicsFont& font_;
   uint8_t contrast_;
 
   Size innerSize_;
@@ -474,7 +467,7 @@ class StaleTextWidget: public Widget {
 public:
   StaleTextWidget(const char* value, size_t maxLength = 0,
       uint32_t staleUs = 1000 * 1000,
-      GeneratorFont& font = Font5x7,
+      GraphicsFont& font = Font5x7,
       uint8_t freshContrast = 255, uint8_t staleContrast = 63) :
       textWidget_(value, maxLength, font, staleContrast),
       staleContainer_(&textWidget_, staleUs, freshContrast, staleContrast) {
@@ -510,9 +503,9 @@ class StaleNumericTextWidget: public Widget {
 public:
   StaleNumericTextWidget(int32_t value, uint8_t maxDigits = 0,
       uint32_t staleUs = 1000 * 1000,
-      GeneratorFont& font = Font5x7,
+      GraphicsFont& font = Font5x7,
       uint8_t freshContrast = 255, uint8_t staleContrast = 63,
-      GeneratorFont& fractionalFont = Font3x5,
+      GraphicsFont& fractionalFont = Font3x5,
       int32_t fractional = 1, uint8_t fractionalDigits = 0) :
       textWidget_(value, maxDigits, font, staleContrast, fractionalFont, fractional, fractionalDigits),
       staleContainer_(&textWidget_, staleUs, freshContrast, staleContrast) {
@@ -0,0 +1,151 @@
+"""
+Reads and writes GeneratorFont C++ source files (the Font*.cpp format), for the font conversion tools.
+
+A font is read into a Font of per-character pixel rows, independent of the glyph layout it was stored
+in, and can be written back in either layout (see GraphicsFont::GlyphLayout in GraphicsApi.h), as a
+GeneratorFont or as a RangeFont of just the characters it has.
+"""
+import re
+
+FIRST_CHAR, LAST_CHAR = 32, 126
+
+
+class Font:
+  def __init__(self, name, height, glyphs, row_major=False):
+    self.name = name
+    self.height = height
+    self.glyphs = glyphs  # character code to rows of 0/1 pixels, width given by the row length
+    self.row_major = row_major
+
+  def width(self, code):
+    return len(self.glyphs[code][0]) if code in self.glyphs and self.glyphs[code] else 0
+
+  def max_width(self):
+    return max([self.width(code) for code in self.glyphs] + [0])
+
+
+def read_font(path):
+  """Parses a Font*.cpp into a Font."""
+  with open(path) as f:
+    source = f.read()
+
+  match = re.search(r'GeneratorFont\s+(\w+)\(\w+::Chars,\s*\w+::Widths,\s*(\d+),\s*\w+::MaxWidth(,\s*GraphicsFont::kRowMajor)?\)',
+                    source)
+  name, height, row_major = match.group(1), int(match.group(2)), match.group(3) is not None
+
+  data = {}
+  for code, body in re.findall(r'const uint8_t Char(\d+)\[\] = \{[^\n]*\n(.*?)\n\};', source, re.S):
+    data[int(code)] = [[int(b, 16) for b in re.findall(r'0x([0-9a-fA-F]{2})', line.split('//')[0])]
+                       for line in body.split('\n')]
+
+  chars = re.search(r'const uint8_t\* Chars\[\] = \{(.*?)\};', source, re.S).group(1)
+  entries = re.findall(r'^\s*(Char\d+|NULL),', chars, re.M)
+  widths = [int(w) for w in re.findall(r'^\s*(\d+),', re.search(r'const uint8_t Widths\[\] = \{(.*?)\};', source, re.S).group(1), re.M)]
+
+  glyphs = {}
+  for code, (entry, width) in enumerate(zip(entries, widths), FIRST_CHAR):
+    if entry == 'NULL':
+      continue
+    lines = data[int(entry[4:])]
+    if row_major:  # a line per row, MSB leftmost
+      glyphs[code] = [[(line[x // 8] >> (7 - x % 8)) & 1 for x in range(width)] for line in lines[:height]]
+    else:  # a line per column, LSB topmost
+      glyphs[code] = [[(lines[x][y // 8] >> (y % 8)) & 1 for x in range(width)] for y in range(height)]
+  return Font(name, height, glyphs, row_major)
+
+
+def char_comment(code):
+  char = chr(code)
+  return char + ' (avoid multiline comment)' if char == '\\' else char
+
+
+def write_glyph(out, font, code, name):
+  """Writes the bit data array of a character, in the font's glyph layout."""
+  rows = font.glyphs[code]
+  width = font.width(code)
+  out.write(f"const uint8_t {name}[] = {{ // {char_comment(code)}\n")
+  if font.row_major:
+    for row in rows:
+      packed = [sum(row[x + i] << (7 - i) for i in range(min(8, width - x))) for x in range(0, width, 8)]
+      out.write("  " + ",".join(f"0x{b:02x}" for b in packed) + ",  // " + ''.join('#' if p else '.' for p in row) + "\n")
+  else:
+    for x in range(width):
+      column = [rows[y][x] for y in range(font.height)]
+      packed = [sum(column[y + i] << i for i in range(min(8, font.height - y))) for y in range(0, font.height, 8)]
+      out.write("  " + ",".join(f"0x{b:02x}" for b in packed) + ",  // "
+                + " ".join(''.join('#' if (b >> (7 - i)) & 1 else '.' for i in range(8)) for b in packed) + "\n")
+  out.write("};\n")
+
+
+def write_font(out, font):
+  """Writes a Font as a Font*.cpp, in its glyph layout."""
+  data_name = f"{font.name}Data"
+  out.write("#include <cstdint>\n")
+  out.write("#include <cstddef>\n\n")
+  out.write(f"namespace {data_name} {{\n")
+  for code in sorted(font.glyphs):
+    write_glyph(out, font, code, f"Char{code}")
+  out.write("\n")
+  out.write("const uint8_t* Chars[] = {\n")
+  for code in range(FIRST_CHAR, LAST_CHAR + 1):
+    entry = f"Char{code}" if code in font.glyphs else "NULL"
+    out.write(f"  {entry},  // '{chr(code)}' {code}\n")
+  out.write("};\n\n")
+  out.write("const uint8_t Widths[] = {\n")
+  for code in range(FIRST_CHAR, LAST_CHAR + 1):
+    out.write(f"  {font.width(code)}, // '{chr(code)}' {code}\n")
+  out.write("};\n")
+  out.write(f"const uint8_t MaxWidth = {font.max_width()};\n")
+  out.write("}\n\n")
+  layout = ", GraphicsFont::kRowMajor" if font.row_major else ""
+  out.write('#include "GraphicsApi.h"\n')
+  out.write(f"GeneratorFont {font.name}({data_name}::Chars, {data_name}::Widths, {font.height}, {data_name}::MaxWidth{layout});\n")
+
+
+def write_range_font(out, font):
+  """Writes a Font as a RangeFont of the characters it has, numbered in character order. Runs of
+  consecutive characters become ranges and the rest sparse glyphs (see RangeFont in GraphicsApi.h)."""
+  data_name = f"{font.name}Data"
+  codes = sorted(font.glyphs)
+  runs = []  # (first character, count, glyph number)
+  for glyph, code in enumerate(codes):
+    if runs and runs[-1][0] + runs[-1][1] == code:
+      runs[-1] = (runs[-1][0], runs[-1][1] + 1, runs[-1][2])
+    else:
+      runs.append((code, 1, glyph))
+  ranges = [run for run in runs if run[1] > 1][:255]
+  sparse = [(code, glyph) for glyph, code in enumerate(codes)
+            if not any(first <= code < first + count for first, count, _ in ranges)]
+
+  out.write("#include <cstdint>\n")
+  out.write("#include <cstddef>\n")
+  out.write('#include "GraphicsApi.h"\n\n')
+  out.write(f"namespace {data_name} {{\n")
+  for glyph, code in enumerate(codes):
+    write_glyph(out, font, code, f"Glyph{glyph}")
+  out.write("\n")
+  out.write("const uint8_t* Glyphs[] = {\n")
+  for glyph, code in enumerate(codes):
+    out.write(f"  Glyph{glyph},  // '{char_comment(code)}' {code}\n")
+  out.write("};\n\n")
+  out.write("const uint8_t Widths[] = {\n")
+  for glyph, code in enumerate(codes):
+    out.write(f"  {font.width(code)}, // '{char_comment(code)}' {code}\n")
+  out.write("};\n\n")
+  if ranges:
+    out.write("const RangeFont::Range Ranges[] = {\n")
+    for first, count, glyph in ranges:
+      out.write(f"  {{{first}, {count}, {glyph}}},  // '{char_comment(first)}'-'{char_comment(first + count - 1)}'\n")
+    out.write("};\n")
+  if sparse:
+    out.write("const RangeFont::SparseGlyph Sparse[] = {\n")
+    for code, glyph in sparse:
+      out.write(f"  {{{code}, {glyph}}},  // '{char_comment(code)}'\n")
+    out.write("};\n")
+  out.write(f"const uint8_t MaxWidth = {font.max_width()};\n")
+  out.write("}\n\n")
+  ranges_arg = f"{data_name}::Ranges, {len(ranges)}" if ranges else "NULL, 0"
+  sparse_arg = f"{data_name}::Sparse, {len(sparse)}" if sparse else "NULL, 0"
+  layout = ", GraphicsFont::kRowMajor" if font.row_major else ""
+  out.write(f"RangeFont {font.name}({ranges_arg}, {sparse_arg},\n"
+            f"    {data_name}::Glyphs, {data_name}::Widths, {font.height}, {data_name}::MaxWidth{layout});\n")
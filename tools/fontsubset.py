@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Subsets a GeneratorFont source file (Font*.cpp) to only the characters a build draws, as a RangeFont
+with its glyphs renumbered densely, so a large display font used for a few digits costs a few KB.
+
+Characters are given as a set like 0-9.- (where - is a range between two characters, and otherwise
+literal) and/or as the strings drawn, and characters the input font does not have are dropped.
+The space is always kept, since widgets pad with it (eg NumericTextWidget) and text() skips characters
+without glyphs, so padded values would lose their padding and shift as they change.
+The glyph layout of the input is kept unless --rows or --columns is given.
+
+Usage: fontsubset.py FontArial32.cpp FontArial32Digits --chars '0-9.-' > FontArial32Digits.cpp
+       fontsubset.py Font5x7.cpp Font5x7Status --string 'Battery' --string 'Charging' > Font5x7Status.cpp
+"""
+import argparse
+import sys
+
+from fontfile import read_font, write_range_font
+
+
+def parse_chars(spec):
+  """Returns the set of character codes of a set like 0-9.-"""
+  codes = set()
+  i = 0
+  while i < len(spec):
+    if i + 2 < len(spec) and spec[i + 1] == '-':
+      codes.update(range(ord(spec[i]), ord(spec[i + 2]) + 1))
+      i += 3
+    else:
+      codes.add(ord(spec[i]))
+      i += 1
+  return codes
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('input', help="font source file")
+  parser.add_argument('name', help="C++ variable name of the generated RangeFont")
+  parser.add_argument('--chars', action='append', default=[], help="set of characters to keep, eg 0-9.-")
+  parser.add_argument('--string', action='append', default=[], help="string drawn with the font, to keep its characters")
+  layout = parser.add_mutually_exclusive_group()
+  layout.add_argument('--rows', action='store_true', help="write the row-major glyph layout")
+  layout.add_argument('--columns', action='store_true', help="write the column-major glyph layout")
+  args = parser.parse_args()
+
+  codes = {ord(' ')}
+  for spec in args.chars:
+    codes |= parse_chars(spec)
+  for string in args.string:
+    codes |= set(ord(char) for char in string)
+  if not args.chars and not args.string:
+    parser.error("no characters given, use --chars or --string")
+
+  font = read_font(args.input)
+  missing = sorted(code for code in codes if code not in font.glyphs)
+  if missing:
+    sys.stderr.write(f"warning: {args.input} has no glyphs for {''.join(chr(code) for code in missing)!r}\n")
+  font.glyphs = {code: rows for code, rows in font.glyphs.items() if code in codes}
+  font.name = args.name
+  if args.rows or args.columns:
+    font.row_major = args.rows
+  write_range_font(sys.stdout, font)
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,28 @@
+#!/usr/bin/env python3
+"""
+Converts a column-major GeneratorFont source file (Font*.cpp) to the row-major glyph layout, where
+each glyph row is bit-packed MSB leftmost, so row-major framebuffers draw text a glyph row at a time.
+
+Usage: glyphrows.py Font5x7.cpp Font5x7Rows > Font5x7Rows.cpp
+"""
+import argparse
+import sys
+
+from fontfile import read_font, write_font
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('input', help="font source file")
+  parser.add_argument('name', help="C++ variable name of the generated GeneratorFont")
+  parser.add_argument('--columns', action='store_true', help="write the column-major layout instead")
+  args = parser.parse_args()
+
+  font = read_font(args.input)
+  font.name = args.name
+  font.row_major = not args.columns
+  write_font(sys.stdout, font)
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Renders a TrueType font into an antialiased GrayFont C++ source file, 4 bits of coverage per pixel.
+
+Characters 32-126 are rendered at the given pixel size (oversampled and box-filtered down, for coverage
+that does not depend on the rasterizer's hinting), cropped horizontally to their ink, and stored as
+GRAY_4BPP rows (see GrayFont in GraphicsApi.h). Requires Pillow.
+
+Usage: grayfont.py UbuntuMono-R.ttf 64 FontUbuntuMono64Gray > FontUbuntuMono64Gray.cpp
+"""
+import argparse
+import sys
+
+from PIL import Image, ImageDraw, ImageFont
+
+SHADES = ' .:-=+*%#@'  # comment art, by coverage
+
+
+def render_char(font, char, ascent, height, oversample):
+  """Returns (width, rows of 0-15 coverage) of a character, cropped to its ink."""
+  advance = int(round(font.getlength(char) / oversample))
+  image = Image.new('L', (max(advance, 1) * oversample + 4 * oversample, height * oversample), 0)
+  ImageDraw.Draw(image).text((2 * oversample, ascent * oversample), char, font=font, fill=255, anchor='ls')
+  image = image.resize((image.width // oversample, height), Image.BOX)
+  pixels = image.load()
+
+  columns = [x for x in range(image.width) if any(pixels[x, y] for y in range(height))]
+  if not columns:  # blank, eg space: the advance width
+    return advance, [[0] * advance for _ in range(height)]
+  left, right = columns[0], columns[-1] + 1
+  return right - left, [[(pixels[x, y] * 15 + 127) // 255 for x in range(left, right)] for y in range(height)]
+
+
+def pack_row(row):
+  """Packs 0-15 coverage values into GRAY_4BPP bytes, MsNibble leftmost."""
+  padded = row + [0]
+  return bytes((padded[x] << 4) | padded[x + 1] for x in range(0, len(row), 2))
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('font', help="TrueType font file")
+  parser.add_argument('size', type=int, help="font height (ascent + descent), in pixels")
+  parser.add_argument('name', help="C++ variable name of the generated GrayFont")
+  parser.add_argument('--oversample', type=int, default=4, help="rendering scale before filtering down")
+  args = parser.parse_args()
+
+  # scale the point size so the line height (ascent + descent) is the requested size
+  probe = ImageFont.truetype(args.font, 100)
+  probe_ascent, probe_descent = probe.getmetrics()
+  point_size = 100 * args.size / (probe_ascent + probe_descent)
+  font = ImageFont.truetype(args.font, int(round(point_size * args.oversample)))
+  ascent = int(round(probe_ascent * point_size / 100))
+  height = args.size
+
+  chars = [render_char(font, chr(c), ascent, height, args.oversample) for c in range(32, 127)]
+
+  out = sys.stdout
+  out.write(f"// {args.font} at {height}px, 4bpp coverage\n")
+  out.write("#include <cstdint>\n")
+  out.write("#include <cstddef>\n\n")
+  out.write(f"namespace {args.name}Data {{\n")
+  for c, (width, rows) in zip(range(32, 127), chars):
+    out.write(f"const uint8_t Char{c}[] = {{ // {chr(c) if c != 92 else 'backslash'}\n")
+    for row in rows:
+      packed = pack_row(row)
+      art = ''.join(SHADES[v * (len(SHADES) - 1) // 15] for v in row)
+      out.write("  " + ",".join(f"0x{b:02x}" for b in packed) + f",  // {art}\n")
+    out.write("};\n")
+  out.write("const uint8_t* Chars[] = {\n")
+  for c in range(32, 127):
+    out.write(f"  Char{c},  // {repr(chr(c))} {c}\n")
+  out.write("};\n")
+  out.write("const uint8_t Widths[] = {\n")
+  for c, (width, rows) in zip(range(32, 127), chars):
+    out.write(f"  {width}, // {repr(chr(c))} {c}\n")
+  out.write("};\n")
+  out.write(f"const uint8_t MaxWidth = {max(width for width, rows in chars)};\n")
+  out.write("}\n\n")
+  out.write('#include "GraphicsApi.h"\n')
+  out.write(f"GrayFont {args.name}({args.name}Data::Chars, {args.name}Data::Widths, {height}, {args.name}Data::MaxWidth);\n")
+
+
+if __name__ == '__main__':
+  main()
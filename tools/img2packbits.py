@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Converts an image into a PackBits-compressed CompressedBitmap C++ source file.
+
+Reads binary PBM / PGM / PPM (P4 / P5 / P6) natively, and PNG (or anything else) if Pillow is
+installed. Pixels are packed into the native row format (see Bitmap in GraphicsApi.h) before
+compression, so decoded rows can be copied straight into a matching framebuffer.
+
+Usage: img2packbits.py input.pgm Splash --format gray4 > Splash.cpp
+"""
+import argparse
+import sys
+
+
+def read_pnm(path):
+  """Returns (width, height, rows of (r, g, b) 8-bit tuples) for a binary PBM, PGM or PPM."""
+  with open(path, 'rb') as f:
+    data = f.read()
+
+  tokens = []
+  pos = 0
+  header_len = 3 if data[:2] == b'P4' else 4
+  while len(tokens) < header_len:
+    while data[pos:pos + 1].isspace():
+      pos += 1
+    if data[pos:pos + 1] == b'#':
+      while data[pos:pos + 1] not in (b'\n', b''):
+        pos += 1
+      continue
+    start = pos
+    while not data[pos:pos + 1].isspace():
+      pos += 1
+    tokens.append(data[start:pos])
+  pos += 1  # single whitespace before the raster
+
+  magic, width, height = tokens[0], int(tokens[1]), int(tokens[2])
+  if magic == b'P4':
+    stride = (width + 7) // 8
+    return width, height, [[(0, 0, 0) if (data[pos + y * stride + x // 8] >> (7 - x % 8)) & 1 else (255, 255, 255)
+                            for x in range(width)] for y in range(height)]
+  maxval = int(tokens[3])
+  assert maxval < 256, "16-bit PNM not supported"
+  scale = lambda v: v * 255 // maxval
+  if magic == b'P5':
+    return width, height, [[(scale(data[pos + y * width + x]),) * 3 for x in range(width)] for y in range(height)]
+  elif magic == b'P6':
+    return width, height, [[tuple(scale(c) for c in data[pos + (y * width + x) * 3:pos + (y * width + x) * 3 + 3])
+                            for x in range(width)] for y in range(height)]
+  raise ValueError(f"unsupported PNM type {magic}")
+
+
+def read_image(path):
+  if path.lower().endswith(('.pbm', '.pgm', '.ppm', '.pnm')):
+    return read_pnm(path)
+  from PIL import Image  # optional dependency, only for non-PNM inputs
+  image = Image.open(path).convert('RGB')
+  pixels = image.load()
+  return image.width, image.height, [[pixels[x, y] for x in range(image.width)] for y in range(image.height)]
+
+
+def pack_row(row, fmt, threshold):
+  """Packs a row of (r, g, b) pixels into bytes in the Bitmap native format."""
+  out = bytearray()
+  if fmt == 'mono1':
+    for x in range(0, len(row), 8):
+      byte = 0
+      for i, (r, g, b) in enumerate(row[x:x + 8]):
+        if (r + g + b) // 3 >= threshold:
+          byte |= 0x80 >> i
+      out.append(byte)
+  elif fmt == 'gray4':
+    for x in range(0, len(row), 2):
+      nibbles = [((r + g + b) // 3) >> 4 for (r, g, b) in row[x:x + 2]] + [0]
+      out.append((nibbles[0] << 4) | nibbles[1])
+  elif fmt == 'rgb444':
+    for x in range(0, len(row), 2):
+      pair = [(r >> 4, g >> 4, b >> 4) for (r, g, b) in row[x:x + 2]] + [(0, 0, 0)]
+      (r0, g0, b0), (r1, g1, b1) = pair[0], pair[1]
+      out += bytes([(r0 << 4) | g0, (b0 << 4) | r1, (g1 << 4) | b1])
+  return out
+
+
+def packbits(data):
+  """PackBits-encodes a byte string: header n >= 0 is n+1 literals, n < 0 is 1-n repeats of one byte."""
+  out = bytearray()
+  i = 0
+  while i < len(data):
+    run = 1
+    while i + run < len(data) and run < 128 and data[i + run] == data[i]:
+      run += 1
+    if run >= 2:
+      out += bytes([(1 - run) & 0xff, data[i]])
+      i += run
+      continue
+
+    start = i
+    while i < len(data) and i - start < 128:
+      if i + 1 < len(data) and data[i + 1] == data[i]:  # a repeat starts here, end the literal
+        break
+      i += 1
+    out.append(i - start - 1)
+    out += data[start:i]
+  return out
+
+
+FORMATS = {
+  'mono1': 'MONO_1BPP',
+  'gray4': 'GRAY_4BPP',
+  'rgb444': 'RGB_444',
+}
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('input', help="input image file")
+  parser.add_argument('name', help="C++ variable name of the generated CompressedBitmap")
+  parser.add_argument('--format', choices=FORMATS.keys(), default='gray4')
+  parser.add_argument('--threshold', type=int, default=128, help="gray level at or above which mono1 pixels are set")
+  args = parser.parse_args()
+
+  width, height, rows = read_image(args.input)
+  raw = bytearray()
+  for row in rows:
+    raw += pack_row(row, args.format, args.threshold)
+  encoded = packbits(raw)
+
+  out = sys.stdout
+  out.write(f"// {args.input}: {width}x{height} {args.format}, {len(raw)} bytes packed, {len(encoded)} bytes compressed\n")
+  out.write("#include <cstdint>\n\n")
+  out.write(f"namespace {args.name}Data {{\n")
+  out.write("const uint8_t Data[] = {\n")
+  for i in range(0, len(encoded), 16):
+    out.write("  " + ",".join(f"0x{b:02x}" for b in encoded[i:i + 16]) + ",\n")
+  out.write("};\n")
+  out.write("}\n\n")
+  out.write('#include "GraphicsApi.h"\n')
+  out.write(f"CompressedBitmap {args.name}(Bitmap::{FORMATS[args.format]}, {width}, {height}, {args.name}Data::Data);\n")
+
+
+if __name__ == '__main__':
+  main()